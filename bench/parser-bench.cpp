@@ -0,0 +1,662 @@
+// Throughput of the loaders, the lexer and the parser over a corpus of generated shaders.
+// Every stage reports MB/s and tokens/s of the source it processes and the allocations one
+// run of it makes. Results can be saved as a JSON baseline and compared with a later run,
+// which then exits with 1 if any stage regressed beyond the threshold.
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/hash-map.hpp>
+#include <engine/core/memory.hpp>
+#include <engine/core/string-interner.hpp>
+#include <engine/core/util.hpp>
+
+#include "shader-lexer.hpp"
+#include "shader-parser.hpp"
+#include "shader-source.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+
+namespace {
+	std::atomic<uint64> allocationCount(0);
+};
+
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* memory = std::malloc(size != 0 ? size : 1)) {
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+namespace {
+	constexpr uint32 FORMAT_VERSION = 1;
+
+	struct CorpusConfig {
+		String name;
+		// uniform and storage blocks, alternating
+		uint32 blocks;
+		uint32 members;
+		// files the declarations are spread over, each including the next
+		uint32 includeDepth;
+		// statements of function bodies, spread over functions of 50
+		uint32 functionLines;
+		// comment lines before every declaration and function
+		uint32 commentLines;
+	};
+
+	const CorpusConfig DEFAULT_CORPORA[] = {
+		{"blocks", 256, 16, 0, 0, 0},
+		{"functions", 8, 8, 0, 20000, 0},
+		{"comments", 32, 8, 0, 500, 12},
+		{"includes", 64, 8, 32, 1000, 1},
+	};
+
+	struct Result {
+		String corpus;
+		String stage;
+		uint64 bytes;
+		uint64 tokens;
+		double seconds;
+		uint64 allocations;
+
+		inline double getMegabytesPerSecond() const { return bytes / seconds / 1e6; }
+		inline double getTokensPerSecond() const { return tokens / seconds; }
+	};
+
+	struct Options {
+		ArrayList<CorpusConfig> corpora;
+		const char* savePath = nullptr;
+		const char* comparePath = nullptr;
+		const char* corpusDirectory = nullptr;
+		double threshold = 10.0;
+		double minTime = 0.2;
+		bool generateOnly = false;
+	};
+
+	constexpr const char* MEMBER_TYPES[] = {
+		"float", "vec2", "vec3", "vec4", "mat4", "int", "uvec4", "mat3"
+	};
+
+	void appendComments(String& out, uint32 lines, uint32 index) {
+		char buffer[128];
+
+		for (uint32 i = 0; i < lines; ++i) {
+			if (i % 4 == 3) {
+				snprintf(buffer, sizeof(buffer), "/* block comment %u of %u: layout(std140) uniform"
+						" Unused { vec4 notAMember; }; */\n", i, index);
+			}
+			else {
+				snprintf(buffer, sizeof(buffer), "// line comment %u of %u, explaining what the"
+						" next declaration is for\n", i, index);
+			}
+
+			out += buffer;
+		}
+	}
+
+	void appendBlock(String& out, uint32 index, uint32 members) {
+		char buffer[128];
+
+		if (index % 2 == 0) {
+			snprintf(buffer, sizeof(buffer), "layout(std140, binding = %u) uniform Uniforms%u {\n",
+					index / 2, index);
+		}
+		else {
+			snprintf(buffer, sizeof(buffer), "layout(std430, binding = %u) buffer Storage%u {\n",
+					index / 2, index);
+		}
+
+		out += buffer;
+
+		for (uint32 i = 0; i < members; ++i) {
+			snprintf(buffer, sizeof(buffer), i % 5 == 4 ? "    %s member%u[4];\n" : "    %s member%u;\n",
+					MEMBER_TYPES[(index + i) % countof(MEMBER_TYPES)], i);
+			out += buffer;
+		}
+
+		out += "};\n\n";
+	}
+
+	void appendFunction(String& out, uint32 index, uint32 lines) {
+		char buffer[128];
+
+		snprintf(buffer, sizeof(buffer), "vec4 function%u(vec4 value, int count) {\n", index);
+		out += buffer;
+
+		for (uint32 i = 0; i < lines; ++i) {
+			switch (i % 4) {
+				case 0:
+					snprintf(buffer, sizeof(buffer), "    value = value * 1.0001 + vec4(float(%u), 2.0,"
+							" 3.0, 4.0);\n", i);
+					break;
+				case 1:
+					snprintf(buffer, sizeof(buffer), "    for (int i%u = 0; i%u < count; ++i%u) {"
+							" value.x += float(i%u); }\n", i, i, i, i);
+					break;
+				case 2:
+					snprintf(buffer, sizeof(buffer), "    if (value.y > %u.5) { value.yz = value.zy *"
+							" 0.5; } else { value.w -= 1.0; }\n", i);
+					break;
+				default:
+					snprintf(buffer, sizeof(buffer), "    value = clamp(value, vec4(0.0), vec4(%u.0));"
+							"\n", i + 1);
+					break;
+			}
+
+			out += buffer;
+		}
+
+		out += "    return value;\n}\n\n";
+	}
+
+	String getFileName(const String& directory, const CorpusConfig& config, uint32 file) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), file == 0 ? ".glsl" : "-%u.glh", file);
+
+		return directory + "/" + config.name + buffer;
+	}
+
+	// writes the corpus as a root file and its include chain, returns the root's name
+	bool generateCorpus(const String& directory, const CorpusConfig& config, String& rootName) {
+		uint32 fileCount = config.includeDepth + 1;
+		uint32 functionCount = (config.functionLines + 49) / 50;
+
+		for (uint32 file = 0; file < fileCount; ++file) {
+			String text;
+
+			if (file == 0) {
+				text += "#version 450\n\n";
+			}
+
+			if (file + 1 < fileCount) {
+				String include = getFileName(directory, config, file + 1);
+				text += "#include \"";
+				text += StringView(include).substr(directory.size() + 1);
+				text += "\"\n\n";
+			}
+
+			char buffer[96];
+			snprintf(buffer, sizeof(buffer), "layout(location = %u) in vec4 attribute%u;\n\n", file,
+					file);
+			text += buffer;
+
+			for (uint32 i = file; i < config.blocks; i += fileCount) {
+				appendComments(text, config.commentLines, i);
+				appendBlock(text, i, config.members);
+			}
+
+			for (uint32 i = file; i < functionCount; i += fileCount) {
+				appendComments(text, config.commentLines, i);
+				appendFunction(text, i, std::min(50u, config.functionLines - i * 50));
+			}
+
+			if (file == 0) {
+				text += "void main() {\n}\n";
+			}
+
+			String fileName = getFileName(directory, config, file);
+			std::ofstream out(fileName.c_str(), std::ios::binary | std::ios::trunc);
+
+			if (!out.write(text.data(), text.size())) {
+				DEBUG_LOG("Bench", LOG_ERROR, "Failed to write corpus file: %s", fileName.c_str());
+				return false;
+			}
+
+			if (file == 0) {
+				rootName = fileName;
+			}
+		}
+
+		return true;
+	}
+
+	// median seconds per call of function over batches of at least a tenth of minTime
+	template <typename Function>
+	double measure(double minTime, Function&& function) {
+		typedef std::chrono::steady_clock Clock;
+
+		uint32 iterations = 1;
+
+		for (;;) {
+			auto start = Clock::now();
+
+			for (uint32 i = 0; i < iterations; ++i) {
+				function();
+			}
+
+			std::chrono::duration<double> elapsed = Clock::now() - start;
+
+			if (elapsed.count() >= minTime / 10.0 || iterations >= (1u << 24)) {
+				break;
+			}
+
+			iterations *= 2;
+		}
+
+		ArrayList<double> batches;
+
+		for (uint32 batch = 0; batch < 9; ++batch) {
+			auto start = Clock::now();
+
+			for (uint32 i = 0; i < iterations; ++i) {
+				function();
+			}
+
+			std::chrono::duration<double> elapsed = Clock::now() - start;
+			batches.push_back(elapsed.count() / iterations);
+		}
+
+		std::nth_element(batches.begin(), batches.begin() + batches.size() / 2, batches.end());
+
+		return batches[batches.size() / 2];
+	}
+
+	// operator new and Memory::malloc, which the engine containers and arenas go through
+	template <typename Function>
+	uint64 countAllocations(Function&& function) {
+		uint64 before = allocationCount.load() + Memory::getAllocationStats().allocations;
+		function();
+
+		return allocationCount.load() + Memory::getAllocationStats().allocations - before;
+	}
+
+	bool runCorpus(const CorpusConfig& config, const String& rootName, double minTime,
+			ArrayList<Result>& results) {
+		ShaderSource source;
+
+		if (!source.load(rootName)) {
+			return false;
+		}
+
+		uint64 bytes = 0;
+		uint64 tokens = 0;
+
+		{
+			ArrayList<ShaderLexer::Token> tokenList;
+
+			for (const auto& span : source.getSpans()) {
+				bytes += span.text.size();
+				ShaderLexer::tokenizeShaderSource(span.text, "", span.line, tokenList);
+			}
+
+			tokens = tokenList.size();
+		}
+
+		{
+			ShaderInfo shaderInfo(Memory::make_shared<StringInterner>());
+
+			if (!shaderInfo.parse(source)) {
+				DEBUG_LOG("Bench", LOG_ERROR, "Generated corpus %s does not parse", config.name.c_str());
+				return false;
+			}
+		}
+
+		auto addResult = [&](const char* stage, auto&& function) {
+			uint64 allocations = countAllocations(function);
+			results.push_back({config.name, stage, bytes, tokens, measure(minTime, function),
+					allocations});
+		};
+
+		addResult("loadFileWithLinking", [&]() {
+			StringStream out;
+			Util::loadFileWithLinking(out, rootName, "#include");
+		});
+
+		addResult("ShaderSource::load", [&]() {
+			ShaderSource loaded;
+			loaded.load(rootName);
+		});
+
+		addResult("tokenizeShaderSource", [&]() {
+			ArrayList<ShaderLexer::Token> tokenList;
+
+			for (const auto& span : source.getSpans()) {
+				ShaderLexer::tokenizeShaderSource(span.text, "", span.line, tokenList);
+			}
+		});
+
+		// a fresh interner every time, so each run interns its strings like a first parse
+		addResult("ShaderInfo::parse", [&]() {
+			ShaderInfo shaderInfo(Memory::make_shared<StringInterner>());
+			shaderInfo.parse(source);
+		});
+
+		addResult("ShaderInfo::parse(declarations)", [&]() {
+			ShaderInfo shaderInfo(Memory::make_shared<StringInterner>());
+			shaderInfo.parse(source, ShaderInfo::ScanMode::DECLARATIONS);
+		});
+
+		return true;
+	}
+
+	void printResults(const ArrayList<Result>& results) {
+		printf("%-10s %-32s %10s %10s %12s %8s\n", "CORPUS", "STAGE", "KB", "MB/s", "Mtokens/s",
+				"ALLOCS");
+
+		for (const Result& result : results) {
+			printf("%-10s %-32s %10.1f %10.1f %12.2f %8llu\n", result.corpus.c_str(),
+					result.stage.c_str(), result.bytes / 1024.0, result.getMegabytesPerSecond(),
+					result.getTokensPerSecond() / 1e6, (unsigned long long)result.allocations);
+		}
+	}
+
+	bool saveResults(const char* path, const ArrayList<Result>& results) {
+		std::ofstream out(path, std::ios::trunc);
+
+		if (!out.is_open()) {
+			DEBUG_LOG("Bench", LOG_ERROR, "Failed to open baseline for writing: %s", path);
+			return false;
+		}
+
+		char buffer[512];
+		snprintf(buffer, sizeof(buffer), "{\n\t\"version\": %u,\n\t\"results\": [\n", FORMAT_VERSION);
+		out << buffer;
+
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& result = results[i];
+
+			// one result per line, which is all loadResults() relies on
+			snprintf(buffer, sizeof(buffer), "\t\t{\"corpus\": \"%s\", \"stage\": \"%s\", \"bytes\": %llu,"
+					" \"tokens\": %llu, \"seconds\": %.9g, \"mb_per_s\": %.3f, \"tokens_per_s\": %.1f,"
+					" \"allocations\": %llu}%s\n", result.corpus.c_str(), result.stage.c_str(),
+					(unsigned long long)result.bytes, (unsigned long long)result.tokens, result.seconds,
+					result.getMegabytesPerSecond(), result.getTokensPerSecond(),
+					(unsigned long long)result.allocations, i + 1 < results.size() ? "," : "");
+			out << buffer;
+		}
+
+		out << "\t]\n}\n";
+
+		return out.good();
+	}
+
+	// value of "key": in a line written by saveResults()
+	bool findField(StringView line, StringView key, StringView& value) {
+		String pattern = String("\"") + key + "\": ";
+		size_t start = line.find(pattern);
+
+		if (start == StringView::npos) {
+			return false;
+		}
+
+		start += pattern.size();
+
+		if (start < line.size() && line[start] == '"') {
+			size_t end = line.find('"', start + 1);
+
+			if (end == StringView::npos) {
+				return false;
+			}
+
+			value = line.substr(start + 1, end - start - 1);
+		}
+		else {
+			size_t end = line.find_first_of(",}", start);
+			value = line.substr(start, end == StringView::npos ? StringView::npos : end - start);
+		}
+
+		return true;
+	}
+
+	bool loadResults(const char* path, ArrayList<Result>& results) {
+		std::ifstream in(path);
+
+		if (!in.is_open()) {
+			DEBUG_LOG("Bench", LOG_ERROR, "Failed to open baseline: %s", path);
+			return false;
+		}
+
+		String line;
+
+		while (getline(in, line)) {
+			StringView corpus;
+			StringView stage;
+			StringView bytes;
+			StringView tokens;
+			StringView seconds;
+			StringView allocations;
+
+			if (findField(line, "version", bytes)
+					&& std::stoul(String(bytes).c_str()) != FORMAT_VERSION) {
+				DEBUG_LOG("Bench", LOG_ERROR, "Baseline %s has an unsupported version", path);
+				return false;
+			}
+
+			if (!findField(line, "corpus", corpus) || !findField(line, "stage", stage)
+					|| !findField(line, "bytes", bytes) || !findField(line, "tokens", tokens)
+					|| !findField(line, "seconds", seconds)
+					|| !findField(line, "allocations", allocations)) {
+				continue;
+			}
+
+			results.push_back({String(corpus), String(stage), std::stoull(String(bytes).c_str()),
+					std::stoull(String(tokens).c_str()), std::stod(String(seconds).c_str()),
+					std::stoull(String(allocations).c_str())});
+		}
+
+		return true;
+	}
+
+	// prints the change of every stage against the baseline, false if any regressed
+	bool compareResults(const ArrayList<Result>& baseline, const ArrayList<Result>& results,
+			double threshold) {
+		HashMap<String, const Result*> baselineStages;
+
+		for (const Result& result : baseline) {
+			baselineStages[result.corpus + "/" + result.stage] = &result;
+		}
+
+		bool regressed = false;
+
+		printf("\n%-10s %-32s %10s %10s %8s %10s\n", "CORPUS", "STAGE", "BASE MB/s", "MB/s", "CHANGE",
+				"ALLOCS");
+
+		for (const Result& result : results) {
+			auto it = baselineStages.find(result.corpus + "/" + result.stage);
+
+			if (it == baselineStages.end()) {
+				printf("%-10s %-32s %10s %10.1f %8s %10llu  (new)\n", result.corpus.c_str(),
+						result.stage.c_str(), "-", result.getMegabytesPerSecond(), "-",
+						(unsigned long long)result.allocations);
+				continue;
+			}
+
+			const Result& base = *it->second;
+
+			if (base.bytes != result.bytes) {
+				printf("%-10s %-32s corpus changed since the baseline, not compared\n",
+						result.corpus.c_str(), result.stage.c_str());
+				continue;
+			}
+
+			// a longer time for the same bytes
+			double change = (base.seconds / result.seconds - 1.0) * 100.0;
+			bool slower = change < -threshold;
+			bool moreAllocations = result.allocations > base.allocations;
+
+			printf("%-10s %-32s %10.1f %10.1f %+7.1f%% %4llu->%-5llu%s\n", result.corpus.c_str(),
+					result.stage.c_str(), base.getMegabytesPerSecond(), result.getMegabytesPerSecond(),
+					change, (unsigned long long)base.allocations, (unsigned long long)result.allocations,
+					slower || moreAllocations ? "  REGRESSION" : "");
+
+			regressed = regressed || slower || moreAllocations;
+		}
+
+		return !regressed;
+	}
+
+	void printUsage(const char* program) {
+		printf("Usage: %s [--save baseline.json] [--compare baseline.json] [--threshold percent]"
+				" [--min-time seconds] [--corpus name]... [--corpus-dir directory [--generate-only]]"
+				" [--blocks N] [--members N] [--include-depth N] [--function-lines N]"
+				" [--comment-lines N]\n", program);
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options) {
+		CorpusConfig custom = {"custom", 0, 8, 0, 0, 0};
+		bool useCustom = false;
+		ArrayList<String> selected;
+
+		for (int i = 1; i < argc; ++i) {
+			StringView arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+			auto customField = [&](uint32& field) {
+				field = (uint32)std::strtoul(value, nullptr, 10);
+				useCustom = true;
+			};
+
+			if (value == nullptr && arg != "--generate-only") {
+				printUsage(argv[0]);
+				return false;
+			}
+
+			if (arg == "--save") {
+				options.savePath = value;
+			}
+			else if (arg == "--compare") {
+				options.comparePath = value;
+			}
+			else if (arg == "--threshold") {
+				options.threshold = std::strtod(value, nullptr);
+			}
+			else if (arg == "--min-time") {
+				options.minTime = std::strtod(value, nullptr);
+			}
+			else if (arg == "--corpus") {
+				selected.push_back(value);
+			}
+			else if (arg == "--corpus-dir") {
+				options.corpusDirectory = value;
+			}
+			else if (arg == "--generate-only") {
+				options.generateOnly = true;
+				continue;
+			}
+			else if (arg == "--blocks") {
+				customField(custom.blocks);
+			}
+			else if (arg == "--members") {
+				customField(custom.members);
+			}
+			else if (arg == "--include-depth") {
+				customField(custom.includeDepth);
+			}
+			else if (arg == "--function-lines") {
+				customField(custom.functionLines);
+			}
+			else if (arg == "--comment-lines") {
+				customField(custom.commentLines);
+			}
+			else {
+				printUsage(argv[0]);
+				return false;
+			}
+
+			++i;
+		}
+
+		if (useCustom) {
+			options.corpora.push_back(custom);
+		}
+		else {
+			for (const CorpusConfig& config : DEFAULT_CORPORA) {
+				if (selected.empty() || std::find(selected.begin(), selected.end(), config.name)
+						!= selected.end()) {
+					options.corpora.push_back(config);
+				}
+			}
+		}
+
+		if (options.generateOnly && options.corpusDirectory == nullptr) {
+			DEBUG_LOG("Bench", LOG_ERROR, "--generate-only needs a --corpus-dir to keep the corpus in");
+			return false;
+		}
+
+		return true;
+	}
+};
+
+int main(int argc, char** argv) {
+	Options options;
+
+	if (!::parseOptions(argc, argv, options)) {
+		return 1;
+	}
+
+	bool temporary = options.corpusDirectory == nullptr;
+	std::error_code error;
+	std::filesystem::path directory = temporary
+			? std::filesystem::temp_directory_path(error)
+					/ ("shader-parser-bench-" + std::to_string(std::random_device()()))
+			: std::filesystem::path(options.corpusDirectory);
+
+	std::filesystem::create_directories(directory, error);
+	String directoryName = directory.string();
+
+	ArrayList<Result> results;
+	bool succeeded = true;
+
+	for (const CorpusConfig& config : options.corpora) {
+		String rootName;
+
+		if (!::generateCorpus(directoryName, config, rootName)) {
+			succeeded = false;
+			break;
+		}
+
+		if (options.generateOnly) {
+			puts(rootName.c_str());
+		}
+		else if (!::runCorpus(config, rootName, options.minTime, results)) {
+			succeeded = false;
+			break;
+		}
+	}
+
+	if (temporary) {
+		std::filesystem::remove_all(directory, error);
+	}
+
+	if (!succeeded || options.generateOnly) {
+		return succeeded ? 0 : 1;
+	}
+
+	::printResults(results);
+
+	if (options.comparePath != nullptr) {
+		ArrayList<Result> baseline;
+
+		if (!::loadResults(options.comparePath, baseline)) {
+			return 1;
+		}
+
+		succeeded = ::compareResults(baseline, results, options.threshold);
+	}
+
+	if (options.savePath != nullptr && !::saveResults(options.savePath, results)) {
+		return 1;
+	}
+
+	return succeeded ? 0 : 1;
+}
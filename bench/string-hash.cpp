@@ -0,0 +1,294 @@
+// Collision quality check and microbenchmark of the String hash against the byte at a time
+// FNV-1a loop it replaced. Exits with 1 if a quality check fails.
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/hash-map.hpp>
+#include <engine/core/array-list.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+	// the hash std::hash<String> used before
+	uint64 fnv1a(const String& str) {
+		uint64 hval = 0xcbf29ce484222325ull;
+		const unsigned char* s = (const unsigned char*)str.c_str();
+
+		while (*s) {
+			hval *= 0x100000001b3ull;
+			hval ^= *s++;
+		}
+
+		return hval;
+	}
+
+	uint64 wordHash(const String& str) {
+		return std::hash<String>()(str);
+	}
+
+	constexpr const char IDENTIFIER_CHARS[]
+			= "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+
+	struct KeySet {
+		const char* name;
+		ArrayList<String> keys;
+	};
+
+	ArrayList<KeySet> makeKeySets() {
+		ArrayList<KeySet> sets;
+
+		sets.push_back({"identifiers of 1 to 3 characters", {}});
+
+		for (uint32 length = 1; length <= 3; ++length) {
+			uint32 total = 1;
+
+			for (uint32 i = 0; i < length; ++i) {
+				total *= sizeof(IDENTIFIER_CHARS) - 1;
+			}
+
+			for (uint32 n = 0; n < total; ++n) {
+				String key;
+
+				for (uint32 i = 0, rest = n; i < length; ++i, rest /= sizeof(IDENTIFIER_CHARS) - 1) {
+					key += IDENTIFIER_CHARS[rest % (sizeof(IDENTIFIER_CHARS) - 1)];
+				}
+
+				sets.back().keys.push_back(key);
+			}
+		}
+
+		sets.push_back({"numbered block members", {}});
+		char buffer[64];
+
+		for (uint32 i = 0; i < 1000; ++i) {
+			for (uint32 j = 0; j < 200; ++j) {
+				snprintf(buffer, sizeof(buffer), "u_block%u.member%u", i, j);
+				sets.back().keys.push_back(buffer);
+			}
+		}
+
+		sets.push_back({"decimal numbers", {}});
+
+		for (uint32 i = 0; i < 500000; ++i) {
+			sets.back().keys.push_back(std::to_string(i));
+		}
+
+		sets.push_back({"long paths differing in one character", {}});
+		String prefix = "shaders/include/lighting/common/";
+
+		for (uint32 i = 0; i < 100000; ++i) {
+			snprintf(buffer, sizeof(buffer), "%08u", i);
+			sets.back().keys.push_back(prefix + buffer + "/brdf.glh");
+		}
+
+		sets.push_back({"keys differing after an embedded NUL", {}});
+
+		for (uint32 i = 0; i < 256; ++i) {
+			String key("name\0", 5);
+			key += (char)i;
+			sets.back().keys.push_back(key);
+		}
+
+		return sets;
+	}
+
+	uint32 countCollisions(const ArrayList<String>& keys, uint64 (*hash)(const String&)) {
+		ArrayList<uint64> hashes;
+		hashes.reserve(keys.size());
+
+		for (const String& key : keys) {
+			hashes.push_back(hash(key));
+		}
+
+		std::sort(hashes.begin(), hashes.end());
+
+		return (uint32)(hashes.size() - (std::unique(hashes.begin(), hashes.end()) - hashes.begin()));
+	}
+
+	// chi-square of the bucket counts over 2^bits buckets taken at shift, as standard
+	// deviations from what a uniform hash gives
+	double bucketDeviation(const ArrayList<String>& keys, uint64 (*hash)(const String&),
+			uint32 shift, uint32 bits) {
+		ArrayList<uint32> buckets(1u << bits);
+
+		for (const String& key : keys) {
+			++buckets[(hash(key) >> shift) & (buckets.size() - 1)];
+		}
+
+		double expected = (double)keys.size() / buckets.size();
+		double chiSquare = 0.0;
+
+		for (uint32 count : buckets) {
+			chiSquare += (count - expected) * (count - expected) / expected;
+		}
+
+		double freedom = buckets.size() - 1.0;
+
+		return (chiSquare - freedom) / std::sqrt(2.0 * freedom);
+	}
+
+	// largest deviation from 1/2 of the probability that an output bit flips when one input
+	// bit does
+	double worstAvalancheBias(uint32 length, uint64 (*hash)(const String&)) {
+		constexpr uint32 SAMPLES = 10000;
+
+		std::mt19937_64 random(length);
+		ArrayList<uint32> flips(length * 8 * 64);
+
+		for (uint32 sample = 0; sample < SAMPLES; ++sample) {
+			String key(std::string(length, ' '));
+
+			for (char& c : key) {
+				c = (char)(random() & 0xff);
+			}
+
+			uint64 base = hash(key);
+
+			for (uint32 bit = 0; bit < length * 8; ++bit) {
+				key[bit / 8] ^= (char)(1 << (bit % 8));
+				uint64 difference = base ^ hash(key);
+				key[bit / 8] ^= (char)(1 << (bit % 8));
+
+				for (uint32 out = 0; out < 64; ++out) {
+					flips[bit * 64 + out] += (difference >> out) & 1;
+				}
+			}
+		}
+
+		double worst = 0.0;
+
+		for (uint32 count : flips) {
+			worst = std::max(worst, std::abs((double)count / SAMPLES - 0.5));
+		}
+
+		return worst;
+	}
+
+	bool checkQuality() {
+		bool passed = true;
+
+		printf("COLLISION QUALITY:\n");
+
+		for (const KeySet& set : makeKeySets()) {
+			uint32 fnvCollisions = ::countCollisions(set.keys, ::fnv1a);
+			uint32 collisions = ::countCollisions(set.keys, ::wordHash);
+			// the low bits pick the group of a HashMap, the top 7 the tag within it
+			double lowDeviation = ::bucketDeviation(set.keys, ::wordHash, 0, 12);
+			double highDeviation = ::bucketDeviation(set.keys, ::wordHash, 57, 7);
+
+			printf("\t%s (%zu keys):\n", set.name, set.keys.size());
+			printf("\t\t64 bit collisions: %u (FNV-1a: %u)\n", collisions, fnvCollisions);
+			printf("\t\tbucket deviation: low 12 bits %.2f, high 7 bits %.2f\n", lowDeviation,
+					highDeviation);
+
+			if (collisions != 0 || std::abs(lowDeviation) > 6.0 || std::abs(highDeviation) > 6.0) {
+				printf("\t\tFAILED\n");
+				passed = false;
+			}
+		}
+
+		for (uint32 length : {4u, 8u, 16u, 24u, 64u}) {
+			double bias = ::worstAvalancheBias(length, ::wordHash);
+			printf("\tworst avalanche bias of %u byte keys: %.3f (FNV-1a: %.3f)\n", length, bias,
+					::worstAvalancheBias(length, ::fnv1a));
+
+			if (bias > 0.05) {
+				printf("\t\tFAILED\n");
+				passed = false;
+			}
+		}
+
+		// hashes of literals computed at compile time must match the run time ones
+		constexpr uint64 STD140_HASH = Hash::hash64("std140");
+		static_assert(STD140_HASH != Hash::hash64("std430"), "literal hashes collide");
+
+		if (STD140_HASH != ::wordHash("std140") || ::wordHash(String("a\0b", 3)) == ::wordHash("a")) {
+			printf("\tcompile time and run time hashes differ\n\t\tFAILED\n");
+			passed = false;
+		}
+
+		return passed;
+	}
+
+	template <typename Function>
+	double measureNanoseconds(uint32 iterations, Function&& function) {
+		auto start = std::chrono::steady_clock::now();
+
+		for (uint32 i = 0; i < iterations; ++i) {
+			function();
+		}
+
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / iterations;
+	}
+
+	void benchmark() {
+		constexpr uint32 KEY_COUNT = 1024;
+
+		std::mt19937 random(7);
+		volatile uint64 sink = 0;
+
+		printf("THROUGHPUT:\n");
+
+		for (uint32 length : {3u, 6u, 12u, 24u, 48u, 128u, 1024u}) {
+			ArrayList<String> keys;
+
+			for (uint32 i = 0; i < KEY_COUNT; ++i) {
+				String key;
+
+				for (uint32 j = 0; j < length; ++j) {
+					key += IDENTIFIER_CHARS[random() % (sizeof(IDENTIFIER_CHARS) - 1)];
+				}
+
+				keys.push_back(key);
+			}
+
+			uint32 iterations = std::max(1u, (1u << 24) / (length * KEY_COUNT));
+
+			double fnvTime = ::measureNanoseconds(iterations, [&]() {
+				for (const String& key : keys) {
+					sink = sink + ::fnv1a(key);
+				}
+			}) / KEY_COUNT;
+
+			double time = ::measureNanoseconds(iterations, [&]() {
+				for (const String& key : keys) {
+					sink = sink + ::wordHash(key);
+				}
+			}) / KEY_COUNT;
+
+			printf("\t%4u bytes: %7.2f ns (%6.2f GB/s), FNV-1a %7.2f ns (%6.2f GB/s), %.1fx\n",
+					length, time, length / time, fnvTime, length / fnvTime, fnvTime / time);
+		}
+
+		// lookups of identifiers in a map the size of a large shader's symbol table
+		HashMap<String, uint32> map;
+		ArrayList<String> names;
+		char buffer[64];
+
+		for (uint32 i = 0; i < 4096; ++i) {
+			snprintf(buffer, sizeof(buffer), "u_material%u.baseColor", i);
+			names.push_back(buffer);
+			map[names.back()] = i;
+		}
+
+		double lookupTime = ::measureNanoseconds(200, [&]() {
+			for (const String& name : names) {
+				sink = sink + map.find(name)->second;
+			}
+		}) / names.size();
+
+		printf("\tHashMap<String, uint32> lookup: %.2f ns\n", lookupTime);
+	}
+};
+
+int main() {
+	bool passed = ::checkQuality();
+	::benchmark();
+
+	return passed ? 0 : 1;
+}
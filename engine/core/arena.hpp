@@ -0,0 +1,165 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/memory.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <type_traits>
+
+namespace Memory {
+	// Fixed size view of elements stored in an Arena
+	template <typename T>
+	class ArenaArray {
+		public:
+			typedef T* iterator;
+			typedef const T* const_iterator;
+
+			ArenaArray() = default;
+
+			inline ArenaArray(T* elements, uint32 count)
+				: elements(elements)
+				, count(count) {}
+
+			inline T* begin() { return elements; }
+			inline T* end() { return elements + count; }
+
+			inline const T* begin() const { return elements; }
+			inline const T* end() const { return elements + count; }
+
+			inline T& operator[](uint32 index) { return elements[index]; }
+			inline const T& operator[](uint32 index) const { return elements[index]; }
+
+			inline T* data() { return elements; }
+			inline const T* data() const { return elements; }
+
+			inline uint32 size() const { return count; }
+			inline bool empty() const { return count == 0; }
+		private:
+			T* elements = nullptr;
+			uint32 count = 0;
+	};
+
+	// Bump allocator handing out memory from a chain of large blocks. Nothing is freed
+	// individually, everything goes at once on reset() or destruction, so only trivially
+	// destructible types may live in it.
+	class Arena {
+		public:
+			explicit inline Arena(uintptr blockSize = 4096)
+				: blockSize(blockSize) {}
+
+			inline ~Arena() {
+				freeBlocks();
+			}
+
+			inline void* allocate(uintptr size, uintptr alignment) {
+				uintptr aligned = ((uintptr)cursor + alignment - 1) & ~(alignment - 1);
+
+				if (cursor == nullptr || aligned + size > (uintptr)limit) {
+					addBlock(size + alignment);
+					aligned = ((uintptr)cursor + alignment - 1) & ~(alignment - 1);
+				}
+
+				cursor = (char*)(aligned + size);
+
+				return (void*)aligned;
+			}
+
+			template <typename T>
+			inline T* allocate(uint32 count) {
+				static_assert(std::is_trivially_destructible<T>::value,
+						"Arena memory is never destructed");
+				return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+			}
+
+			inline StringView copyString(StringView str) {
+				if (str.empty()) {
+					return StringView();
+				}
+
+				char* data = allocate<char>((uint32)str.size());
+				Memory::memcpy(data, str.data(), str.size());
+
+				return StringView(data, str.size());
+			}
+
+			template <typename T>
+			inline ArenaArray<T> copyArray(const T* elements, uint32 count) {
+				static_assert(std::is_trivially_copyable<T>::value,
+						"Arena arrays are copied bytewise");
+
+				if (count == 0) {
+					return ArenaArray<T>();
+				}
+
+				T* data = allocate<T>(count);
+				Memory::memcpy(data, elements, sizeof(T) * count);
+
+				return ArenaArray<T>(data, count);
+			}
+
+			// releases everything but the first block, which is kept for reuse
+			inline void reset() {
+				if (head == nullptr) {
+					return;
+				}
+
+				Block* first = head;
+
+				while (first->next != nullptr) {
+					Block* next = first->next;
+					Memory::free(first);
+					first = next;
+				}
+
+				head = first;
+				cursor = (char*)(head + 1);
+				limit = cursor + head->size;
+			}
+
+			inline uintptr getBytesReserved() const {
+				uintptr total = 0;
+
+				for (Block* block = head; block != nullptr; block = block->next) {
+					total += block->size;
+				}
+
+				return total;
+			}
+		private:
+			NULL_COPY_AND_ASSIGN(Arena);
+
+			struct Block {
+				Block* next;
+				uintptr size;
+			};
+
+			Block* head = nullptr;
+			char* cursor = nullptr;
+			char* limit = nullptr;
+
+			uintptr blockSize;
+
+			inline void addBlock(uintptr minSize) {
+				uintptr size = minSize > blockSize ? minSize : blockSize;
+				Block* block = static_cast<Block*>(Memory::malloc(sizeof(Block) + size));
+
+				block->next = head;
+				block->size = size;
+				head = block;
+
+				cursor = (char*)(block + 1);
+				limit = cursor + size;
+			}
+
+			inline void freeBlocks() {
+				while (head != nullptr) {
+					Block* next = head->next;
+					Memory::free(head);
+					head = next;
+				}
+
+				cursor = nullptr;
+				limit = nullptr;
+			}
+	};
+};
@@ -1,5 +1,168 @@
 #pragma once
 
+#include <engine/core/common.hpp>
+#include <engine/core/memory.hpp>
+
+#include <new>
+#include <utility>
 #include <vector>
 
 #define ArrayList std::vector
+
+// Array list keeping its first N elements inline, for the many short lists that would
+// otherwise cost a heap allocation each. Past N the elements move to the heap, like an
+// ArrayList they are contiguous and growing invalidates pointers to them.
+template <typename T, uint32 N>
+class SmallArrayList {
+	static_assert(N != 0, "SmallArrayList needs inline storage");
+
+	public:
+		typedef T value_type;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+
+		SmallArrayList() = default;
+
+		inline SmallArrayList(const SmallArrayList& other) {
+			*this = other;
+		}
+
+		inline SmallArrayList(SmallArrayList&& other) {
+			*this = std::move(other);
+		}
+
+		inline ~SmallArrayList() {
+			clear();
+
+			if (!isInline()) {
+				Memory::free(elements);
+			}
+		}
+
+		SmallArrayList& operator=(const SmallArrayList& other) {
+			if (this != &other) {
+				clear();
+				reserve(other.count);
+
+				for (const T& value : other) {
+					new (&elements[count++]) T(value);
+				}
+			}
+
+			return *this;
+		}
+
+		SmallArrayList& operator=(SmallArrayList&& other) {
+			if (this == &other) {
+				return *this;
+			}
+
+			clear();
+
+			if (!other.isInline()) {
+				// the heap buffer is taken over, only inline elements have to be moved
+				if (!isInline()) {
+					Memory::free(elements);
+				}
+
+				elements = other.elements;
+				count = other.count;
+				capacity = other.capacity;
+
+				other.elements = other.getStorage();
+				other.count = 0;
+				other.capacity = N;
+			}
+			else {
+				reserve(other.count);
+
+				for (T& value : other) {
+					new (&elements[count++]) T(std::move(value));
+				}
+
+				other.clear();
+			}
+
+			return *this;
+		}
+
+		inline iterator begin() { return elements; }
+		inline iterator end() { return elements + count; }
+		inline const_iterator begin() const { return elements; }
+		inline const_iterator end() const { return elements + count; }
+
+		inline T* data() { return elements; }
+		inline const T* data() const { return elements; }
+
+		inline size_t size() const { return count; }
+		inline bool empty() const { return count == 0; }
+
+		inline T& operator[](size_t index) { return elements[index]; }
+		inline const T& operator[](size_t index) const { return elements[index]; }
+
+		inline T& front() { return elements[0]; }
+		inline const T& front() const { return elements[0]; }
+		inline T& back() { return elements[count - 1]; }
+		inline const T& back() const { return elements[count - 1]; }
+
+		inline void push_back(const T& value) {
+			emplace_back(value);
+		}
+
+		inline void push_back(T&& value) {
+			emplace_back(std::move(value));
+		}
+
+		template <typename... Args>
+		inline T& emplace_back(Args&&... args) {
+			if (count == capacity) {
+				// args may refer to an element, which stays valid until it is moved
+				T value(std::forward<Args>(args)...);
+				grow(capacity * 2);
+
+				return *new (&elements[count++]) T(std::move(value));
+			}
+
+			return *new (&elements[count++]) T(std::forward<Args>(args)...);
+		}
+
+		inline void pop_back() {
+			elements[--count].~T();
+		}
+
+		inline void clear() {
+			while (count != 0) {
+				elements[--count].~T();
+			}
+		}
+
+		inline void reserve(size_t size) {
+			if (size > capacity) {
+				grow((uint32)size);
+			}
+		}
+	private:
+		inline T* getStorage() { return reinterpret_cast<T*>(storage); }
+		inline bool isInline() const { return elements == reinterpret_cast<const T*>(storage); }
+
+		void grow(uint32 newCapacity) {
+			T* newElements = (T*)Memory::malloc(sizeof(T) * newCapacity);
+
+			for (uint32 i = 0; i < count; ++i) {
+				new (&newElements[i]) T(std::move(elements[i]));
+				elements[i].~T();
+			}
+
+			if (!isInline()) {
+				Memory::free(elements);
+			}
+
+			elements = newElements;
+			capacity = newCapacity;
+		}
+
+		alignas(T) unsigned char storage[sizeof(T) * N];
+		T* elements = getStorage();
+		uint32 count = 0;
+		uint32 capacity = N;
+};
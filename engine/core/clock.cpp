@@ -0,0 +1,23 @@
+#include "engine/core/clock.hpp"
+
+#include <thread>
+
+double Clock::getNanosecondsPerTick() {
+#ifdef CLOCK_TIME_STAMP_COUNTER
+	static const double nanosecondsPerTick = []() {
+		auto start = std::chrono::steady_clock::now();
+		uint64 startTicks = Clock::now();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		uint64 ticks = Clock::now() - startTicks;
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return ticks != 0 ? elapsed.count() / ticks : 1.0;
+	}();
+
+	return nanosecondsPerTick;
+#else
+	return 1.0;
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+
+#include <chrono>
+
+#if defined(COMPILER_MSVC) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+
+	#define CLOCK_TIME_STAMP_COUNTER
+#elif (defined(COMPILER_GCC) || defined(COMPILER_CLANG)) && (defined(__x86_64__) || defined(__i386__))
+	#include <x86intrin.h>
+
+	#define CLOCK_TIME_STAMP_COUNTER
+#endif
+
+// Timestamps cheap enough to take around every token. On x86 they are read from the time
+// stamp counter, which costs a few cycles instead of the system call or vDSO trip of
+// steady_clock, and converted to nanoseconds with a rate measured once. Elsewhere a tick is
+// a steady_clock nanosecond.
+namespace Clock {
+	FORCEINLINE uint64 now() {
+#ifdef CLOCK_TIME_STAMP_COUNTER
+		return (uint64)__rdtsc();
+#else
+		return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// the first call of a process takes a few milliseconds to measure the tick rate
+	double getNanosecondsPerTick();
+
+	inline uint64 toNanoseconds(uint64 ticks) {
+		return (uint64)(ticks * getNanosecondsPerTick());
+	}
+};
@@ -47,6 +47,12 @@ typedef uintptr_t uintptr;
 	#define PACKED
 #endif
 
+// instrumentation (allocation counters, phase timers), build with -DENABLE_STATS=0 to
+// compile it out entirely
+#ifndef ENABLE_STATS
+	#define ENABLE_STATS 1
+#endif
+
 #define NULL_COPY_AND_ASSIGN(T) \
 	T(T&& other) = delete; \
 	T(const T& other) = delete; \
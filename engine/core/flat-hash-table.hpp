@@ -0,0 +1,396 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/memory.hpp>
+
+#include <functional>
+#include <new>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+
+	#define FLAT_HASH_TABLE_SSE2
+#endif
+
+namespace Detail {
+	// Open addressing hash table storing its elements in one flat array. Every slot has a
+	// control byte, either empty, deleted or the low 7 bits of the hash of its element, and
+	// slots are probed 16 at a time: one SIMD compare of a group of control bytes finds the
+	// candidates of a lookup, so a key is only compared against slots with a matching tag.
+	// Inserting may move elements, which invalidates iterators and references.
+	template <typename Value, typename KeyOf, typename Hash, typename Equal>
+	class FlatHashTable {
+		public:
+			static constexpr uint32 GROUP_SIZE = 16;
+
+			template <typename T>
+			class Iterator {
+				public:
+					inline Iterator(const int8* control, T* slots, uint32 index, uint32 capacity)
+						: control(control)
+						, slots(slots)
+						, index(index)
+						, capacity(capacity) {
+						skipEmpty();
+					}
+
+					inline T& operator*() const { return slots[index]; }
+					inline T* operator->() const { return &slots[index]; }
+
+					inline Iterator& operator++() {
+						++index;
+						skipEmpty();
+
+						return *this;
+					}
+
+					inline bool operator==(const Iterator& other) const { return index == other.index; }
+					inline bool operator!=(const Iterator& other) const { return index != other.index; }
+
+					// a non-const iterator converts to a const one
+					inline operator Iterator<const T>() const {
+						return Iterator<const T>(control, slots, index, capacity);
+					}
+				private:
+					inline void skipEmpty() {
+						while (index < capacity && control[index] < 0) {
+							++index;
+						}
+					}
+
+					const int8* control;
+					T* slots;
+					uint32 index;
+					uint32 capacity;
+			};
+
+			typedef Iterator<Value> iterator;
+			typedef Iterator<const Value> const_iterator;
+
+			FlatHashTable() = default;
+
+			inline FlatHashTable(const FlatHashTable& other) {
+				*this = other;
+			}
+
+			inline FlatHashTable(FlatHashTable&& other) {
+				*this = std::move(other);
+			}
+
+			inline ~FlatHashTable() {
+				release();
+			}
+
+			inline FlatHashTable& operator=(const FlatHashTable& other) {
+				if (this != &other) {
+					clear();
+					reserve(other.elementCount);
+
+					for (const Value& value : other) {
+						insertUnique(hashOf(KeyOf::get(value)), value);
+					}
+				}
+
+				return *this;
+			}
+
+			inline FlatHashTable& operator=(FlatHashTable&& other) {
+				if (this != &other) {
+					release();
+
+					control = other.control;
+					slots = other.slots;
+					capacity = other.capacity;
+					elementCount = other.elementCount;
+					deletedCount = other.deletedCount;
+
+					other.control = nullptr;
+					other.slots = nullptr;
+					other.capacity = other.elementCount = other.deletedCount = 0;
+				}
+
+				return *this;
+			}
+
+			inline iterator begin() { return iterator(control, slots, 0, capacity); }
+			inline iterator end() { return iterator(control, slots, capacity, capacity); }
+			inline const_iterator begin() const { return const_iterator(control, slots, 0, capacity); }
+			inline const_iterator end() const { return const_iterator(control, slots, capacity, capacity); }
+
+			inline size_t size() const { return elementCount; }
+			inline bool empty() const { return elementCount == 0; }
+
+			template <typename K>
+			inline iterator find(const K& key) {
+				uint32 index = findIndex(key);
+				return index != capacity ? iterator(control, slots, index, capacity) : end();
+			}
+
+			template <typename K>
+			inline const_iterator find(const K& key) const {
+				uint32 index = findIndex(key);
+				return index != capacity ? const_iterator(control, slots, index, capacity) : end();
+			}
+
+			template <typename K>
+			inline size_t count(const K& key) const {
+				return findIndex(key) != capacity ? 1 : 0;
+			}
+
+			// constructs the element from args unless key is present, the bool is true if it was
+			// inserted
+			template <typename K, typename... Args>
+			std::pair<iterator, bool> emplaceKey(const K& key, Args&&... args) {
+				uint64 hash = hashOf(key);
+				uint32 index = findIndex(key, hash);
+
+				if (index != capacity) {
+					return {iterator(control, slots, index, capacity), false};
+				}
+
+				index = insertUnique(hash, std::forward<Args>(args)...);
+
+				return {iterator(control, slots, index, capacity), true};
+			}
+
+			template <typename K>
+			size_t erase(const K& key) {
+				uint32 index = findIndex(key);
+
+				if (index == capacity) {
+					return 0;
+				}
+
+				slots[index].~Value();
+				--elementCount;
+
+				// a slot in a group without empty slots may be in the middle of a probe sequence
+				uint32 group = index & ~(GROUP_SIZE - 1);
+
+				if (matchEmpty(group) != 0) {
+					control[index] = EMPTY;
+				}
+				else {
+					control[index] = DELETED;
+					++deletedCount;
+				}
+
+				return 1;
+			}
+
+			void clear() {
+				for (uint32 i = 0; i < capacity; ++i) {
+					if (control[i] >= 0) {
+						slots[i].~Value();
+					}
+				}
+
+				if (capacity != 0) {
+					Memory::memset(control, EMPTY, capacity);
+				}
+
+				elementCount = 0;
+				deletedCount = 0;
+			}
+
+			void reserve(size_t elements) {
+				uint32 needed = GROUP_SIZE;
+
+				while ((uint64)needed * 7 / 8 < elements) {
+					needed *= 2;
+				}
+
+				if (needed > capacity) {
+					rehash(needed);
+				}
+			}
+		private:
+			static constexpr int8 EMPTY = -128;
+			static constexpr int8 DELETED = -2;
+
+			template <typename K>
+			static inline uint64 hashOf(const K& key) {
+				// spreads the bits of weak hashes such as the identity hash of integers
+				uint64 hash = (uint64)Hash()(key);
+				hash ^= hash >> 32;
+				hash *= 0x9e3779b97f4a7c15ull;
+
+				return hash ^ (hash >> 29);
+			}
+
+			static inline int8 tagOf(uint64 hash) {
+				return (int8)(hash & 0x7f);
+			}
+
+			// bit i is set if control byte i of the group equals tag
+			inline uint32 match(uint32 group, int8 tag) const {
+#ifdef FLAT_HASH_TABLE_SSE2
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(control + group));
+				return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+#else
+				uint32 mask = 0;
+
+				for (uint32 i = 0; i < GROUP_SIZE; ++i) {
+					mask |= (uint32)(control[group + i] == tag) << i;
+				}
+
+				return mask;
+#endif
+			}
+
+			inline uint32 matchEmpty(uint32 group) const {
+				return match(group, EMPTY);
+			}
+
+			// empty or deleted, the only control bytes with the sign bit set
+			inline uint32 matchFree(uint32 group) const {
+#ifdef FLAT_HASH_TABLE_SSE2
+				return (uint32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(control + group)));
+#else
+				uint32 mask = 0;
+
+				for (uint32 i = 0; i < GROUP_SIZE; ++i) {
+					mask |= (uint32)(control[group + i] < 0) << i;
+				}
+
+				return mask;
+#endif
+			}
+
+			static inline uint32 lowestBit(uint32 mask) {
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+				return (uint32)__builtin_ctz(mask);
+#else
+				uint32 bit = 0;
+
+				while ((mask & 1) == 0) {
+					mask >>= 1;
+					++bit;
+				}
+
+				return bit;
+#endif
+			}
+
+			template <typename K>
+			inline uint32 findIndex(const K& key) const {
+				return findIndex(key, hashOf(key));
+			}
+
+			// capacity if key is not present
+			template <typename K>
+			uint32 findIndex(const K& key, uint64 hash) const {
+				if (capacity == 0) {
+					return capacity;
+				}
+
+				uint32 groupMask = capacity / GROUP_SIZE - 1;
+				uint32 group = (uint32)(hash >> 7) & groupMask;
+				int8 tag = tagOf(hash);
+
+				// triangular probing visits every group once when their number is a power of 2
+				for (uint32 step = 1; ; ++step) {
+					uint32 first = group * GROUP_SIZE;
+
+					for (uint32 mask = match(first, tag); mask != 0; mask &= mask - 1) {
+						uint32 index = first + lowestBit(mask);
+
+						if (Equal()(KeyOf::get(slots[index]), key)) {
+							return index;
+						}
+					}
+
+					if (matchEmpty(first) != 0 || step > groupMask) {
+						return capacity;
+					}
+
+					group = (group + step) & groupMask;
+				}
+			}
+
+			// the key must not be present
+			template <typename... Args>
+			uint32 insertUnique(uint64 hash, Args&&... args) {
+				if ((uint64)(elementCount + deletedCount + 1) * 8 > (uint64)capacity * 7) {
+					// a table filled up mostly by tombstones is only cleaned, not grown
+					rehash(elementCount * 2 + 2 > capacity ? (capacity != 0 ? capacity * 2 : GROUP_SIZE)
+							: capacity);
+				}
+
+				uint32 index = findFree(hash);
+
+				if (control[index] == DELETED) {
+					--deletedCount;
+				}
+
+				control[index] = tagOf(hash);
+				new (&slots[index]) Value(std::forward<Args>(args)...);
+				++elementCount;
+
+				return index;
+			}
+
+			uint32 findFree(uint64 hash) const {
+				uint32 groupMask = capacity / GROUP_SIZE - 1;
+				uint32 group = (uint32)(hash >> 7) & groupMask;
+
+				for (uint32 step = 1; ; ++step) {
+					uint32 first = group * GROUP_SIZE;
+					uint32 mask = matchFree(first);
+
+					if (mask != 0) {
+						return first + lowestBit(mask);
+					}
+
+					group = (group + step) & groupMask;
+				}
+			}
+
+			void rehash(uint32 newCapacity) {
+				int8* oldControl = control;
+				Value* oldSlots = slots;
+				uint32 oldCapacity = capacity;
+
+				control = (int8*)Memory::malloc(newCapacity);
+				slots = (Value*)Memory::malloc(sizeof(Value) * newCapacity);
+				capacity = newCapacity;
+				elementCount = 0;
+				deletedCount = 0;
+
+				Memory::memset(control, EMPTY, newCapacity);
+
+				for (uint32 i = 0; i < oldCapacity; ++i) {
+					if (oldControl[i] >= 0) {
+						uint64 hash = hashOf(KeyOf::get(oldSlots[i]));
+						uint32 index = findFree(hash);
+
+						control[index] = tagOf(hash);
+						new (&slots[index]) Value(std::move(oldSlots[i]));
+						oldSlots[i].~Value();
+						++elementCount;
+					}
+				}
+
+				Memory::free(oldControl);
+				Memory::free(oldSlots);
+			}
+
+			void release() {
+				clear();
+
+				Memory::free(control);
+				Memory::free(slots);
+
+				control = nullptr;
+				slots = nullptr;
+				capacity = 0;
+			}
+
+			int8* control = nullptr;
+			Value* slots = nullptr;
+			uint32 capacity = 0;
+			uint32 elementCount = 0;
+			uint32 deletedCount = 0;
+	};
+};
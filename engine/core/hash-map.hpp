@@ -1,6 +1,80 @@
 #pragma once
 
-#include <unordered_map>
+#include <engine/core/flat-hash-table.hpp>
+
+#include <tuple>
 
-#define HashMap std::unordered_map
 #define Pair std::pair
+
+// Flat hash map with the interface of std::unordered_map that the engine uses. Elements
+// live in the table itself, so inserting may move them: iterators and references are only
+// valid until the next insertion.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+class HashMap {
+	private:
+		struct KeyOf {
+			static inline const K& get(const Pair<const K, V>& value) { return value.first; }
+		};
+
+		typedef Detail::FlatHashTable<Pair<const K, V>, KeyOf, Hash, Equal> Table;
+	public:
+		typedef K key_type;
+		typedef V mapped_type;
+		typedef Pair<const K, V> value_type;
+		typedef typename Table::iterator iterator;
+		typedef typename Table::const_iterator const_iterator;
+
+		HashMap() = default;
+
+		inline HashMap(std::initializer_list<value_type> values) {
+			table.reserve(values.size());
+
+			for (const value_type& value : values) {
+				insert(value);
+			}
+		}
+
+		inline iterator begin() { return table.begin(); }
+		inline iterator end() { return table.end(); }
+		inline const_iterator begin() const { return table.begin(); }
+		inline const_iterator end() const { return table.end(); }
+
+		inline size_t size() const { return table.size(); }
+		inline bool empty() const { return table.empty(); }
+
+		inline iterator find(const K& key) { return table.find(key); }
+		inline const_iterator find(const K& key) const { return table.find(key); }
+		inline size_t count(const K& key) const { return table.count(key); }
+
+		inline V& operator[](const K& key) {
+			return table.emplaceKey(key, std::piecewise_construct, std::forward_as_tuple(key),
+					std::forward_as_tuple()).first->second;
+		}
+
+		inline V& operator[](K&& key) {
+			return table.emplaceKey(key, std::piecewise_construct,
+					std::forward_as_tuple(std::move(key)), std::forward_as_tuple()).first->second;
+		}
+
+		template <typename Key, typename... Args>
+		inline Pair<iterator, bool> emplace(Key&& key, Args&&... args) {
+			const K& k = key;
+			return table.emplaceKey(k, std::piecewise_construct,
+					std::forward_as_tuple(std::forward<Key>(key)),
+					std::forward_as_tuple(std::forward<Args>(args)...));
+		}
+
+		inline Pair<iterator, bool> insert(const value_type& value) {
+			return table.emplaceKey(value.first, value);
+		}
+
+		inline Pair<iterator, bool> insert(value_type&& value) {
+			return table.emplaceKey(value.first, std::move(value));
+		}
+
+		inline size_t erase(const K& key) { return table.erase(key); }
+		inline void clear() { table.clear(); }
+		inline void reserve(size_t size) { table.reserve(size); }
+	private:
+		Table table;
+};
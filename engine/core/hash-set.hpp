@@ -1,6 +1,52 @@
 #pragma once
 
-#include <unordered_set>
+#include <engine/core/flat-hash-table.hpp>
 
-#define HashSet std::unordered_set
+// Flat hash set with the interface of std::unordered_set that the engine uses, inserting
+// invalidates iterators
+template <typename T, typename Hash = std::hash<T>, typename Equal = std::equal_to<T>>
+class HashSet {
+	private:
+		struct KeyOf {
+			static inline const T& get(const T& value) { return value; }
+		};
 
+		typedef Detail::FlatHashTable<T, KeyOf, Hash, Equal> Table;
+	public:
+		typedef T key_type;
+		typedef T value_type;
+		// elements are the keys and can't be changed in place
+		typedef typename Table::const_iterator iterator;
+		typedef typename Table::const_iterator const_iterator;
+
+		HashSet() = default;
+
+		inline const_iterator begin() const { return table.begin(); }
+		inline const_iterator end() const { return table.end(); }
+
+		inline size_t size() const { return table.size(); }
+		inline bool empty() const { return table.empty(); }
+
+		inline const_iterator find(const T& value) const { return table.find(value); }
+		inline size_t count(const T& value) const { return table.count(value); }
+
+		inline std::pair<const_iterator, bool> insert(const T& value) {
+			return table.emplaceKey(value, value);
+		}
+
+		inline std::pair<const_iterator, bool> insert(T&& value) {
+			return table.emplaceKey(value, std::move(value));
+		}
+
+		template <typename... Args>
+		inline std::pair<const_iterator, bool> emplace(Args&&... args) {
+			T value(std::forward<Args>(args)...);
+			return insert(std::move(value));
+		}
+
+		inline size_t erase(const T& value) { return table.erase(value); }
+		inline void clear() { table.clear(); }
+		inline void reserve(size_t size) { table.reserve(size); }
+	private:
+		Table table;
+};
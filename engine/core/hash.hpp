@@ -0,0 +1,127 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string-view.hpp>
+
+// Fast non-cryptographic hashing of byte ranges, following the construction of wyhash:
+// input is read eight bytes at a time and folded with 64x64->128 bit multiplies, so
+// hashing costs about a multiply per eight bytes instead of one per byte. Everything is
+// constexpr, the hash of a string literal can be computed at compile time and is the same
+// as the one computed at run time.
+namespace Hash {
+	namespace Detail {
+		constexpr uint64 SECRET0 = 0xa0761d6478bd642full;
+		constexpr uint64 SECRET1 = 0xe7037ed1a0b428dbull;
+		constexpr uint64 SECRET2 = 0x8ebc6af09c88c6e3ull;
+		constexpr uint64 SECRET3 = 0x589965cc75374cc3ull;
+
+		// low and high halves of a * b
+		constexpr void multiply(uint64& a, uint64& b) {
+#ifdef __SIZEOF_INT128__
+			__uint128_t product = (__uint128_t)a * b;
+			a = (uint64)product;
+			b = (uint64)(product >> 64);
+#else
+			// 32 bit halves, as _umul128 can't be used in constant expressions
+			uint64 aHigh = a >> 32;
+			uint64 aLow = (uint32)a;
+			uint64 bHigh = b >> 32;
+			uint64 bLow = (uint32)b;
+
+			uint64 low = aLow * bLow;
+			uint64 middle1 = aHigh * bLow;
+			uint64 middle2 = aLow * bHigh;
+			uint64 high = aHigh * bHigh;
+			uint64 carry = ((low >> 32) + (uint32)middle1 + (uint32)middle2) >> 32;
+
+			a = low + (middle1 << 32) + (middle2 << 32);
+			b = high + (middle1 >> 32) + (middle2 >> 32) + carry;
+#endif
+		}
+
+		constexpr uint64 mix(uint64 a, uint64 b) {
+			multiply(a, b);
+			return a ^ b;
+		}
+
+		// little endian reads assembled from bytes, which compilers turn into a single load
+		constexpr uint64 read32(const char* p) {
+			return (uint64)(uint8)p[0] | ((uint64)(uint8)p[1] << 8) | ((uint64)(uint8)p[2] << 16)
+					| ((uint64)(uint8)p[3] << 24);
+		}
+
+		constexpr uint64 read64(const char* p) {
+			return read32(p) | (read32(p + 4) << 32);
+		}
+
+		// 1 to 3 bytes
+		constexpr uint64 readSmall(const char* p, uintptr size) {
+			return ((uint64)(uint8)p[0] << 16) | ((uint64)(uint8)p[size >> 1] << 8)
+					| (uint8)p[size - 1];
+		}
+	};
+
+	constexpr uint64 hash64(const char* data, uintptr size, uint64 seed = 0) {
+		using namespace Detail;
+
+		const char* p = data;
+		uint64 a = 0;
+		uint64 b = 0;
+
+		seed ^= mix(seed ^ SECRET0, SECRET1);
+
+		if (size <= 16) {
+			if (size >= 4) {
+				uintptr middle = (size >> 3) << 2;
+				a = (read32(p) << 32) | read32(p + middle);
+				b = (read32(p + size - 4) << 32) | read32(p + size - 4 - middle);
+			}
+			else if (size > 0) {
+				a = readSmall(p, size);
+			}
+		}
+		else {
+			uintptr remaining = size;
+
+			if (remaining > 48) {
+				uint64 seed1 = seed;
+				uint64 seed2 = seed;
+
+				do {
+					seed = mix(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+					seed1 = mix(read64(p + 16) ^ SECRET2, read64(p + 24) ^ seed1);
+					seed2 = mix(read64(p + 32) ^ SECRET3, read64(p + 40) ^ seed2);
+					p += 48;
+					remaining -= 48;
+				}
+				while (remaining > 48);
+
+				seed ^= seed1 ^ seed2;
+			}
+
+			while (remaining > 16) {
+				seed = mix(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+				p += 16;
+				remaining -= 16;
+			}
+
+			// the last 16 bytes, overlapping what was already consumed
+			a = read64(p + remaining - 16);
+			b = read64(p + remaining - 8);
+		}
+
+		a ^= SECRET1;
+		b ^= seed;
+		multiply(a, b);
+
+		return mix(a ^ SECRET0 ^ size, b ^ SECRET1);
+	}
+
+	inline uint64 hash64(const void* data, uintptr size, uint64 seed = 0) {
+		return hash64((const char*)data, size, seed);
+	}
+
+	constexpr uint64 hash64(StringView str, uint64 seed = 0) {
+		return hash64(str.data(), str.size(), seed);
+	}
+};
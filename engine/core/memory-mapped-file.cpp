@@ -0,0 +1,190 @@
+#include "engine/core/memory-mapped-file.hpp"
+
+#include <engine/core/memory.hpp>
+
+#if defined(OPERATING_SYSTEM_WINDOWS)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#elif defined(OPERATING_SYSTEM_LINUX) || defined(OPERATING_SYSTEM_MACOS)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#else
+	#include <fstream>
+#endif
+
+namespace {
+	// mapping an empty file fails on most platforms, so empty files all share this
+	const char EMPTY_FILE[1] = {};
+};
+
+MemoryMappedFile::~MemoryMappedFile() {
+	close();
+}
+
+#if defined(OPERATING_SYSTEM_WINDOWS)
+
+bool MemoryMappedFile::open(const String& fileName) {
+	close();
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	if (fileSize.QuadPart == 0) {
+		CloseHandle(file);
+
+		data = EMPTY_FILE;
+		size = 0;
+
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const char*>(view);
+	size = (uintptr)fileSize.QuadPart;
+
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (mappingHandle != nullptr) {
+		UnmapViewOfFile(data);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+	}
+
+	data = nullptr;
+	size = 0;
+}
+
+#elif defined(OPERATING_SYSTEM_LINUX) || defined(OPERATING_SYSTEM_MACOS)
+
+bool MemoryMappedFile::open(const String& fileName) {
+	close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+
+	if (fd == -1) {
+		return false;
+	}
+
+	struct stat fileInfo;
+
+	if (fstat(fd, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	if (fileInfo.st_size == 0) {
+		::close(fd);
+
+		data = EMPTY_FILE;
+		size = 0;
+
+		return true;
+	}
+
+	void* view = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps its own reference to the file
+	::close(fd);
+
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	madvise(view, (size_t)fileInfo.st_size, MADV_SEQUENTIAL);
+
+	data = static_cast<const char*>(view);
+	size = (uintptr)fileInfo.st_size;
+
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (data != nullptr && data != EMPTY_FILE) {
+		munmap(const_cast<char*>(data), size);
+	}
+
+	data = nullptr;
+	size = 0;
+}
+
+#else
+
+bool MemoryMappedFile::open(const String& fileName) {
+	close();
+
+	std::ifstream file(fileName.c_str(), std::ios::binary | std::ios::ate);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	uintptr fileSize = (uintptr)file.tellg();
+
+	if (fileSize == 0) {
+		data = EMPTY_FILE;
+		size = 0;
+
+		return true;
+	}
+
+	char* buffer = static_cast<char*>(Memory::malloc(fileSize));
+
+	file.seekg(0);
+
+	if (!file.read(buffer, fileSize)) {
+		Memory::free(buffer);
+		return false;
+	}
+
+	data = buffer;
+	size = fileSize;
+	ownsBuffer = true;
+
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (ownsBuffer) {
+		Memory::free(const_cast<char*>(data));
+		ownsBuffer = false;
+	}
+
+	data = nullptr;
+	size = 0;
+}
+
+#endif
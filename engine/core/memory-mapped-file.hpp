@@ -0,0 +1,35 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+// Read-only view of a whole file. Uses the OS mapping facilities where available and
+// falls back to reading the file into a heap buffer otherwise.
+class MemoryMappedFile {
+	public:
+		MemoryMappedFile() = default;
+		~MemoryMappedFile();
+
+		bool open(const String& fileName);
+		void close();
+
+		inline bool isOpen() const { return data != nullptr; }
+
+		inline const char* getData() const { return data; }
+		inline uintptr getSize() const { return size; }
+
+		inline StringView getView() const { return StringView(data, size); }
+	private:
+		NULL_COPY_AND_ASSIGN(MemoryMappedFile);
+
+		const char* data = nullptr;
+		uintptr size = 0;
+
+#if defined(OPERATING_SYSTEM_WINDOWS)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#elif !defined(OPERATING_SYSTEM_LINUX) && !defined(OPERATING_SYSTEM_MACOS)
+		bool ownsBuffer = false;
+#endif
+};
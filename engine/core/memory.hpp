@@ -30,11 +30,41 @@ namespace Memory {
 			const uint32 id;
 	};
 
+	// calls of malloc and free made by one thread, all zero when stats are compiled out
+	struct AllocationStats {
+		uint64 allocations = 0;
+		uint64 frees = 0;
+		uint64 allocatedBytes = 0;
+	};
+
+	namespace Detail {
+#if ENABLE_STATS
+		inline thread_local AllocationStats allocationStats;
+#endif
+	};
+
+	inline AllocationStats getAllocationStats() {
+#if ENABLE_STATS
+		return Detail::allocationStats;
+#else
+		return {};
+#endif
+	}
+
 	FORCEINLINE void* malloc(size_t size) {
+#if ENABLE_STATS
+		++Detail::allocationStats.allocations;
+		Detail::allocationStats.allocatedBytes += size;
+#endif
+
 		return std::malloc(size);
 	}
 
 	FORCEINLINE void free(void* ptr) {
+#if ENABLE_STATS
+		Detail::allocationStats.frees += ptr != nullptr;
+#endif
+
 		std::free(ptr);
 	}
 
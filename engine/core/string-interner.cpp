@@ -0,0 +1,67 @@
+#include "engine/core/string-interner.hpp"
+
+#include <mutex>
+
+Memory::SharedPointer<StringInterner> StringInterner::getGlobal() {
+	static Memory::SharedPointer<StringInterner> interner = Memory::make_shared<StringInterner>();
+	return interner;
+}
+
+StringInterner::StringInterner()
+		: storage(16384) {
+	symbols.emplace(StringView(), EMPTY_SYMBOL);
+	strings.emplace_back();
+}
+
+StringInterner::Symbol StringInterner::intern(StringView str) {
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+
+		auto it = symbols.find(str);
+
+		if (it != symbols.end()) {
+			return it->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	// another thread may have added it between the two locks
+	auto it = symbols.find(str);
+
+	if (it != symbols.end()) {
+		return it->second;
+	}
+
+	StringView stored = storage.copyString(str);
+	Symbol symbol = (Symbol)strings.size();
+
+	strings.push_back(stored);
+	symbols.emplace(stored, symbol);
+
+	return symbol;
+}
+
+bool StringInterner::find(StringView str, Symbol& symbol) const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+
+	auto it = symbols.find(str);
+
+	if (it == symbols.end()) {
+		return false;
+	}
+
+	symbol = it->second;
+
+	return true;
+}
+
+StringView StringInterner::get(Symbol symbol) const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return strings[symbol];
+}
+
+uint32 StringInterner::getSize() const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return (uint32)strings.size();
+}
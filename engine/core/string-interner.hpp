@@ -0,0 +1,42 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/arena.hpp>
+#include <engine/core/array-list.hpp>
+#include <engine/core/hash-map.hpp>
+#include <engine/core/memory.hpp>
+
+#include <shared_mutex>
+
+// Maps strings to small integer ids. Each distinct string is stored once and keeps its id
+// for the lifetime of the interner, so interned strings compare with a single integer
+// compare. Safe to share between threads.
+class StringInterner {
+	public:
+		typedef uint32 Symbol;
+
+		// the empty string, always present
+		static constexpr Symbol EMPTY_SYMBOL = 0;
+
+		static Memory::SharedPointer<StringInterner> getGlobal();
+
+		StringInterner();
+
+		Symbol intern(StringView str);
+		// returns false and leaves symbol untouched if str was never interned
+		bool find(StringView str, Symbol& symbol) const;
+
+		StringView get(Symbol symbol) const;
+
+		uint32 getSize() const;
+	private:
+		NULL_COPY_AND_ASSIGN(StringInterner);
+
+		mutable std::shared_mutex mutex;
+
+		Memory::Arena storage;
+		HashMap<StringView, Symbol> symbols;
+		ArrayList<StringView> strings;
+};
@@ -1,68 +1,437 @@
 #pragma once
 
+#include <engine/core/common.hpp>
+#include <engine/core/hash.hpp>
+#include <engine/core/memory.hpp>
+#include <engine/core/string-view.hpp>
+
 #include <algorithm>
+#include <cctype>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
 
 #include <string>
 #include <sstream>
 
 #define StringStream std::stringstream
 
-class String : public std::string {
+// Byte string with the subset of the std::string interface the engine uses. Up to
+// INLINE_CAPACITY characters, which covers nearly every GLSL identifier, file name and
+// define, are stored in the object itself without a heap allocation. A String converts
+// implicitly to a StringView, which is how it is passed to anything that only reads it.
+class String {
 	public:
-		inline String()
-				: std::string() {}
+		typedef char value_type;
+		typedef char* iterator;
+		typedef const char* const_iterator;
+
+		static constexpr size_t npos = ~(size_t)0;
+		static constexpr size_t INLINE_CAPACITY = 23;
 
-		inline String(const char* cStr, size_t len)
-				: std::string(cStr, len) {}
+		inline String() {
+			initInline();
+		}
+
+		inline String(const char* cStr, size_t len) {
+			initInline();
+			append(cStr, len);
+		}
 
 		inline String(const char* cStr)
-				: std::string(cStr) {}
+				: String(cStr, std::char_traits<char>::length(cStr)) {}
 
+		inline explicit String(StringView str)
+				: String(str.data(), str.size()) {}
+
+		// std::string can't hand over its buffer, both copy the characters once
 		inline String(const std::string& str)
-				: std::string(str) {}
+				: String(str.data(), str.size()) {}
 
-		inline String(std::string&& str)
-				: std::string(str) {}
+		inline String(const String& other)
+				: String(other.data(), other.size()) {}
 
-		inline String to_lower() const {
-			String res(*this);
-			std::transform(res.begin(), res.end(), res.begin(), ::tolower);
+		inline String(String&& other) noexcept {
+			Memory::memcpy((void*)this, &other, sizeof(String));
+			other.initInline();
+		}
+
+		inline ~String() {
+			if (isHeap()) {
+				Memory::free(heap.data);
+			}
+		}
+
+		inline String& operator=(const String& other) {
+			if (this != &other) {
+				assign(other.data(), other.size());
+			}
+
+			return *this;
+		}
+
+		inline String& operator=(String&& other) noexcept {
+			if (this != &other) {
+				this->~String();
+				Memory::memcpy((void*)this, &other, sizeof(String));
+				other.initInline();
+			}
+
+			return *this;
+		}
+
+		inline String& operator=(StringView str) {
+			return assign(str.data(), str.size());
+		}
+
+		inline String& operator=(const char* cStr) {
+			return assign(cStr, std::char_traits<char>::length(cStr));
+		}
+
+		inline operator StringView() const noexcept {
+			return StringView(data(), size());
+		}
+
+		inline char* data() { return isHeap() ? heap.data : buffer; }
+		inline const char* data() const { return isHeap() ? heap.data : buffer; }
+		inline const char* c_str() const { return data(); }
+
+		inline size_t size() const { return sizeAndFlag & ~HEAP_FLAG; }
+		inline size_t length() const { return size(); }
+		inline bool empty() const { return size() == 0; }
+		inline size_t capacity() const { return isHeap() ? heap.capacity : INLINE_CAPACITY; }
+
+		inline iterator begin() { return data(); }
+		inline iterator end() { return data() + size(); }
+		inline const_iterator begin() const { return data(); }
+		inline const_iterator end() const { return data() + size(); }
+
+		inline char& operator[](size_t index) { return data()[index]; }
+		inline const char& operator[](size_t index) const { return data()[index]; }
+
+		inline char& front() { return data()[0]; }
+		inline const char& front() const { return data()[0]; }
+		inline char& back() { return data()[size() - 1]; }
+		inline const char& back() const { return data()[size() - 1]; }
+
+		inline void reserve(size_t newCapacity) {
+			if (newCapacity > capacity()) {
+				grow(newCapacity);
+			}
+		}
+
+		inline void resize(size_t newSize, char c = '\0') {
+			size_t oldSize = size();
+			reserve(newSize);
+
+			if (newSize > oldSize) {
+				Memory::memset(data() + oldSize, c, newSize - oldSize);
+			}
+
+			setSize(newSize);
+		}
+
+		inline void clear() {
+			setSize(0);
+		}
+
+		inline String& assign(const char* str, size_t len) {
+			clear();
+			return append(str, len);
+		}
+
+		inline String& append(const char* str, size_t len) {
+			// str may be null then, which memmove doesn't allow
+			if (len == 0) {
+				return *this;
+			}
+
+			size_t oldSize = size();
+
+			if (oldSize + len > capacity()) {
+				// str may point into this string, whose characters are about to move
+				uintptr offset = (uintptr)str - (uintptr)data();
+				grow(std::max(oldSize + len, capacity() * 2));
+
+				if (offset <= oldSize) {
+					str = data() + offset;
+				}
+			}
+
+			Memory::memmove(data() + oldSize, str, len);
+			setSize(oldSize + len);
+
+			return *this;
+		}
+
+		inline String& append(StringView str) {
+			return append(str.data(), str.size());
+		}
+
+		inline void push_back(char c) {
+			size_t oldSize = size();
+
+			if (oldSize == capacity()) {
+				grow(capacity() * 2);
+			}
+
+			data()[oldSize] = c;
+			setSize(oldSize + 1);
+		}
+
+		inline void pop_back() {
+			setSize(size() - 1);
+		}
+
+		inline String& operator+=(char c) {
+			push_back(c);
+			return *this;
+		}
+
+		inline String& operator+=(StringView str) {
+			return append(str);
+		}
+
+		inline String& operator+=(const String& str) {
+			return append(str.data(), str.size());
+		}
+
+		inline String& operator+=(const char* cStr) {
+			return append(cStr, std::char_traits<char>::length(cStr));
+		}
+
+		inline String substr(size_t pos = 0, size_t len = npos) const {
+			if (pos > size()) {
+				throw std::out_of_range("String::substr");
+			}
+
+			return String(data() + pos, std::min(len, size() - pos));
+		}
+
+		inline int32 compare(StringView str) const {
+			return StringView(*this).compare(str);
+		}
+
+		inline int32 compare(size_t pos, size_t len, StringView str) const {
+			return StringView(*this).compare(pos, len, str);
+		}
+
+		inline size_t find(char c, size_t pos = 0) const {
+			return StringView(*this).find(c, pos);
+		}
+
+		inline size_t find(StringView str, size_t pos = 0) const {
+			return StringView(*this).find(str, pos);
+		}
+
+		inline size_t rfind(char c, size_t pos = npos) const {
+			return StringView(*this).rfind(c, pos);
+		}
 
-			return res;
+		inline size_t rfind(StringView str, size_t pos = npos) const {
+			return StringView(*this).rfind(str, pos);
+		}
+
+		inline size_t find_first_of(StringView chars, size_t pos = 0) const {
+			return StringView(*this).find_first_of(chars, pos);
+		}
+
+		inline size_t find_last_of(StringView chars, size_t pos = npos) const {
+			return StringView(*this).find_last_of(chars, pos);
+		}
+
+		inline size_t find_first_not_of(StringView chars, size_t pos = 0) const {
+			return StringView(*this).find_first_not_of(chars, pos);
+		}
+
+		inline size_t find_last_not_of(StringView chars, size_t pos = npos) const {
+			return StringView(*this).find_last_not_of(chars, pos);
+		}
+
+		inline String to_lower() const {
+			return transformed(::tolower);
 		}
 
 		inline String to_upper() const {
-			String res(*this);
-			std::transform(res.begin(), res.end(), res.begin(), ::toupper);
+			return transformed(::toupper);
+		}
+
+		inline bool starts_with(StringView prefix) const {
+			return size() >= prefix.size()
+					&& Memory::memcmp(data(), prefix.data(), prefix.size()) == 0;
+		}
+
+		inline bool ends_with(StringView suffix) const {
+			return size() >= suffix.size()
+					&& Memory::memcmp(end() - suffix.size(), suffix.data(), suffix.size()) == 0;
+		}
+
+		friend inline bool operator==(const String& a, const String& b) {
+			return a.size() == b.size() && Memory::memcmp(a.data(), b.data(), a.size()) == 0;
+		}
+
+		friend inline bool operator==(const String& a, StringView b) { return StringView(a) == b; }
+		friend inline bool operator==(StringView a, const String& b) { return a == StringView(b); }
+		friend inline bool operator==(const String& a, const char* b) { return StringView(a) == b; }
+		friend inline bool operator==(const char* a, const String& b) { return a == StringView(b); }
+
+		friend inline bool operator!=(const String& a, const String& b) { return !(a == b); }
+		friend inline bool operator!=(const String& a, StringView b) { return !(a == b); }
+		friend inline bool operator!=(StringView a, const String& b) { return !(a == b); }
+		friend inline bool operator!=(const String& a, const char* b) { return !(a == b); }
+		friend inline bool operator!=(const char* a, const String& b) { return !(a == b); }
+
+		friend inline bool operator<(const String& a, const String& b) { return a.compare(b) < 0; }
+		friend inline bool operator>(const String& a, const String& b) { return a.compare(b) > 0; }
+		friend inline bool operator<=(const String& a, const String& b) { return a.compare(b) <= 0; }
+		friend inline bool operator>=(const String& a, const String& b) { return a.compare(b) >= 0; }
+
+		friend inline String operator+(const String& a, StringView b) {
+			return concatenate(a, b);
+		}
+
+		friend inline String operator+(const String& a, const String& b) {
+			return concatenate(a, b);
+		}
+
+		friend inline String operator+(const String& a, const char* b) {
+			return concatenate(a, b);
+		}
+
+		friend inline String operator+(const char* a, const String& b) {
+			return concatenate(a, b);
+		}
+
+		friend inline String operator+(String&& a, StringView b) {
+			return std::move(a.append(b));
+		}
+
+		friend inline String operator+(String&& a, const String& b) {
+			return std::move(a.append(b));
+		}
+
+		friend inline String operator+(String&& a, const char* b) {
+			return std::move(a.append(b));
+		}
+
+		friend inline String operator+(const String& a, char b) {
+			String result;
+			result.reserve(a.size() + 1);
+			result.append(a);
+			result.push_back(b);
 
-			return res;
+			return result;
 		}
 
-		inline bool starts_with(const String& prefix) const {
-			return compare(0, prefix.length(), prefix) == 0;
+		friend inline std::ostream& operator<<(std::ostream& stream, const String& str) {
+			return stream.write(str.data(), str.size());
 		}
+	private:
+		// set in sizeAndFlag while the characters are in a heap allocation
+		static constexpr size_t HEAP_FLAG = ~(~(size_t)0 >> 1);
+
+		inline bool isHeap() const { return (sizeAndFlag & HEAP_FLAG) != 0; }
+
+		inline void initInline() {
+			buffer[0] = '\0';
+			sizeAndFlag = 0;
+		}
+
+		inline void setSize(size_t newSize) {
+			sizeAndFlag = (sizeAndFlag & HEAP_FLAG) | newSize;
+			data()[newSize] = '\0';
+		}
+
+		void grow(size_t newCapacity) {
+			char* newData = (char*)Memory::malloc(newCapacity + 1);
+			size_t oldSize = size();
+			Memory::memcpy(newData, data(), oldSize + 1);
+
+			if (isHeap()) {
+				Memory::free(heap.data);
+			}
+
+			heap.data = newData;
+			heap.capacity = newCapacity;
+			sizeAndFlag = oldSize | HEAP_FLAG;
+		}
+
+		// written straight into the result, without copying this string first
+		inline String transformed(int (*function)(int)) const {
+			String result;
+			result.resize(size());
+
+			const char* source = data();
+			char* dest = result.data();
+
+			for (size_t i = 0, n = size(); i < n; ++i) {
+				dest[i] = (char)function((unsigned char)source[i]);
+			}
+
+			return result;
+		}
+
+		static inline String concatenate(StringView a, StringView b) {
+			String result;
+			result.reserve(a.size() + b.size());
+			result.append(a);
+			result.append(b);
+
+			return result;
+		}
+
+		union {
+			char buffer[INLINE_CAPACITY + 1];
+
+			struct {
+				char* data;
+				size_t capacity;
+			} heap;
+		};
+
+		size_t sizeAndFlag;
 };
 
-namespace std {
-	/*template <>
-	struct hash<String> {
-		inline size_t operator()(const String& str) const {
-			return std::hash<std::string>()((std::string)str);
+// std::getline() for a String
+inline std::istream& getline(std::istream& stream, String& str, char delim = '\n') {
+	std::istream::sentry sentry(stream, true);
+
+	if (!sentry) {
+		return stream;
+	}
+
+	str.clear();
+
+	std::streambuf* input = stream.rdbuf();
+	bool extracted = false;
+
+	for (;;) {
+		int c = input->sbumpc();
+
+		if (c == std::char_traits<char>::eof()) {
+			stream.setstate(extracted ? std::ios::eofbit : std::ios::eofbit | std::ios::failbit);
+			break;
 		}
-	};*/
 
+		extracted = true;
+
+		if ((char)c == delim) {
+			break;
+		}
+
+		str.push_back((char)c);
+	}
+
+	return stream;
+}
+
+namespace std {
+	// length aware, so embedded NULs take part, and equal to Hash::hash64() of the same
+	// characters, which also works on literals at compile time
 	template <>
 	struct hash<String> {
 		inline size_t operator()(const String& str) const {
-			uint64_t hval = (uint64_t)0xcbf29ce484222325ULL;
-            const unsigned char *s = (const unsigned char*)str.c_str();
-
-            while (*s) {
-                hval *= (uint64_t)0x100000001b3ULL;
-                hval ^= (uint64_t)(*s++);
-            }
-
-            return (size_t)hval;
+			return (size_t)Hash::hash64(str.data(), str.size());
 		}
 	};
 };
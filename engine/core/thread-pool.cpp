@@ -0,0 +1,145 @@
+#include "engine/core/thread-pool.hpp"
+
+ThreadPool::ThreadPool(uint32 numThreads)
+		: nextQueue(0)
+		, pendingTasks(0)
+		, running(true) {
+	if (numThreads == 0) {
+		numThreads = std::thread::hardware_concurrency();
+
+		if (numThreads == 0) {
+			numThreads = 1;
+		}
+	}
+
+	for (uint32 i = 0; i < numThreads; ++i) {
+		queues.push_back(Memory::make_unique<Queue>());
+	}
+
+	for (uint32 i = 0; i < numThreads; ++i) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	wait();
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+
+	workAvailable.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::submit(Task task) {
+	uint32 index = nextQueue.fetch_add(1, std::memory_order_relaxed) % (uint32)queues.size();
+
+	pendingTasks.fetch_add(1, std::memory_order_acq_rel);
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		// taking the lock orders the push against a worker about to sleep
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+
+	workAvailable.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32 count, const std::function<void(uint32)>& func) {
+	for (uint32 i = 0; i < count; ++i) {
+		submit([&func, i] { func(i); });
+	}
+
+	wait();
+}
+
+void ThreadPool::wait() {
+	uint32 index = 0;
+
+	while (pendingTasks.load(std::memory_order_acquire) != 0) {
+		if (tryRunTask(index)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		workDone.wait(lock, [this] {
+			return pendingTasks.load(std::memory_order_acquire) == 0;
+		});
+	}
+}
+
+void ThreadPool::workerLoop(uint32 index) {
+	for (;;) {
+		if (tryRunTask(index)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+
+		if (!running) {
+			return;
+		}
+
+		bool hasWork = false;
+
+		for (auto& queue : queues) {
+			std::lock_guard<std::mutex> queueLock(queue->mutex);
+
+			if (!queue->tasks.empty()) {
+				hasWork = true;
+				break;
+			}
+		}
+
+		if (!hasWork) {
+			workAvailable.wait(lock);
+		}
+	}
+}
+
+bool ThreadPool::tryRunTask(uint32 index) {
+	Task task;
+	uint32 numQueues = (uint32)queues.size();
+
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+		}
+	}
+
+	for (uint32 i = 1; !task && i < numQueues; ++i) {
+		Queue& victim = *queues[(index + i) % numQueues];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+
+	if (!task) {
+		return false;
+	}
+
+	task();
+
+	if (pendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		workDone.notify_all();
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/array-list.hpp>
+#include <engine/core/memory.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed size pool of workers, each with its own task queue. Workers take from the back of
+// their own queue and steal from the front of the others' when it runs dry, so uneven task
+// costs balance out without a single contended queue.
+class ThreadPool {
+	public:
+		typedef std::function<void()> Task;
+
+		// numThreads == 0 uses one worker per hardware thread
+		explicit ThreadPool(uint32 numThreads = 0);
+		~ThreadPool();
+
+		void submit(Task task);
+
+		// runs count tasks, calling func(i) for i in [0, count), and waits for all of them
+		void parallelFor(uint32 count, const std::function<void(uint32)>& func);
+
+		// blocks until every submitted task has finished, helping out in the meantime
+		void wait();
+
+		inline uint32 getThreadCount() const { return (uint32)workers.size(); }
+	private:
+		NULL_COPY_AND_ASSIGN(ThreadPool);
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		ArrayList<std::thread> workers;
+		ArrayList<Memory::UniquePointer<Queue>> queues;
+
+		std::mutex sleepMutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workDone;
+
+		std::atomic<uint32> nextQueue;
+		std::atomic<uint32> pendingTasks;
+		bool running;
+
+		void workerLoop(uint32 index);
+		bool tryRunTask(uint32 index);
+};
@@ -0,0 +1,168 @@
+#include "engine/core/trace.hpp"
+
+#include <engine/core/memory.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+	struct ThreadBuffer {
+		Trace::Event* events;
+		// only the owning thread stores, the release pairs with the acquire in write()
+		std::atomic<uint64> written;
+		uint32 threadID;
+		ThreadBuffer* next;
+	};
+
+	// pushed to without a lock, never removed
+	std::atomic<ThreadBuffer*> threadBuffers(nullptr);
+	std::atomic<uint32> threadCount(0);
+	std::atomic<uint64> origin(0);
+
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+
+	ThreadBuffer* createThreadBuffer();
+	void writeEscaped(std::ofstream& file, const char* str);
+};
+
+void Trace::Detail::record(const char* name, StringView detail, uint64 start, uint64 end) {
+	ThreadBuffer* buffer = ::threadBuffer;
+
+	if (buffer == nullptr) {
+		buffer = ::threadBuffer = ::createThreadBuffer();
+	}
+
+	uint64 index = buffer->written.load(std::memory_order_relaxed);
+	Event& event = buffer->events[index & (EVENTS_PER_THREAD - 1)];
+
+	event.start = start;
+	event.end = end;
+	event.name = name;
+
+	if (detail.size() >= Event::DETAIL_SIZE) {
+		detail.remove_prefix(detail.size() - (Event::DETAIL_SIZE - 1));
+
+		// not starting in the middle of a UTF-8 sequence keeps the JSON valid
+		while (!detail.empty() && ((unsigned char)detail[0] & 0xc0) == 0x80) {
+			detail.remove_prefix(1);
+		}
+	}
+
+	// a scope without a detail has no data to copy from
+	if (!detail.empty()) {
+		Memory::memcpy(event.detail, detail.data(), detail.size());
+	}
+
+	event.detail[detail.size()] = '\0';
+
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Trace::start() {
+	// measured now rather than on the clock of the first thread that needs it
+	Clock::getNanosecondsPerTick();
+
+	origin.store(Clock::now(), std::memory_order_relaxed);
+	Detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop() {
+	Detail::enabled.store(false, std::memory_order_relaxed);
+}
+
+bool Trace::write(const String& fileName) {
+	std::ofstream file(fileName.c_str(), std::ios::trunc);
+
+	if (!file.is_open()) {
+		DEBUG_LOG("Trace", LOG_ERROR, "Failed to open trace file: %s", fileName.c_str());
+		return false;
+	}
+
+	uint64 startTicks = origin.load(std::memory_order_relaxed);
+	double microsecondsPerTick = Clock::getNanosecondsPerTick() / 1000.0;
+	uint64 overwritten = 0;
+	bool first = true;
+	char number[64];
+
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	for (ThreadBuffer* buffer = threadBuffers.load(std::memory_order_acquire); buffer != nullptr;
+			buffer = buffer->next) {
+		uint64 written = buffer->written.load(std::memory_order_acquire);
+		uint64 begin = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+		overwritten += begin;
+
+		for (uint64 i = begin; i < written; ++i) {
+			const Event& event = buffer->events[i & (EVENTS_PER_THREAD - 1)];
+
+			if (event.start < startTicks) {
+				continue;
+			}
+
+			file << (first ? "\n" : ",\n") << "{\"name\": \"";
+			::writeEscaped(file, event.name);
+
+			snprintf(number, sizeof(number), "\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f",
+					(event.start - startTicks) * microsecondsPerTick,
+					(event.end - event.start) * microsecondsPerTick);
+			file << number << ", \"pid\": 1, \"tid\": " << buffer->threadID;
+
+			if (event.detail[0] != '\0') {
+				file << ", \"args\": {\"detail\": \"";
+				::writeEscaped(file, event.detail);
+				file << "\"}";
+			}
+
+			file << "}";
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+
+	if (overwritten != 0) {
+		DEBUG_LOG("Trace", LOG_WARNING, "%llu trace events were overwritten by newer ones",
+				(unsigned long long)overwritten);
+	}
+
+	if (!file.flush()) {
+		DEBUG_LOG("Trace", LOG_ERROR, "Failed to write trace file: %s", fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+namespace {
+	ThreadBuffer* createThreadBuffer() {
+		ThreadBuffer* buffer = new ThreadBuffer;
+		buffer->events = (Trace::Event*)Memory::malloc(sizeof(Trace::Event)
+				* Trace::EVENTS_PER_THREAD);
+		buffer->written.store(0, std::memory_order_relaxed);
+		buffer->threadID = threadCount.fetch_add(1, std::memory_order_relaxed);
+		buffer->next = threadBuffers.load(std::memory_order_relaxed);
+
+		while (!threadBuffers.compare_exchange_weak(buffer->next, buffer,
+				std::memory_order_release, std::memory_order_relaxed)) {}
+
+		return buffer;
+	}
+
+	void writeEscaped(std::ofstream& file, const char* str) {
+		for (; *str != '\0'; ++str) {
+			char c = *str;
+
+			if (c == '"' || c == '\\') {
+				file << '\\' << c;
+			}
+			else if ((unsigned char)c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+				file << escaped;
+			}
+			else {
+				file << c;
+			}
+		}
+	}
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/clock.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <atomic>
+
+// Timeline of what every thread was doing, written as a Chrome trace (chrome://tracing,
+// ui.perfetto.dev). Each thread records its scopes into a ring buffer of its own without
+// locking, so recording costs two time stamp reads and one 64 byte store, and a scope costs
+// a single relaxed load while tracing is off. A full ring overwrites its oldest events.
+namespace Trace {
+	struct Event {
+		static constexpr uint32 DETAIL_SIZE = 40;
+
+		uint64 start;
+		uint64 end;
+		const char* name;
+		// NUL terminated, the end of a longer detail is kept since it tells paths apart
+		char detail[DETAIL_SIZE];
+	};
+
+	// per thread, the buffers of threads that exit are kept for write()
+	static constexpr uint32 EVENTS_PER_THREAD = 1 << 15;
+
+	namespace Detail {
+		inline std::atomic<bool> enabled(false);
+
+		void record(const char* name, StringView detail, uint64 start, uint64 end);
+	};
+
+	// events recorded before the latest start() are not written
+	void start();
+	void stop();
+
+	inline bool isEnabled() {
+		return Detail::enabled.load(std::memory_order_relaxed);
+	}
+
+	// the events of every thread as Chrome trace JSON, threads must not record meanwhile
+	bool write(const String& fileName);
+
+	// Records the time between its construction and destruction as one event. name must
+	// outlive the trace (a literal), detail only the scope.
+	class Scope {
+		public:
+			FORCEINLINE explicit Scope(const char* name, StringView detail = StringView())
+				: name(name)
+				, detail(detail)
+				, start(isEnabled() ? Clock::now() : 0) {}
+
+			FORCEINLINE ~Scope() {
+				if (start != 0) {
+					Detail::record(name, detail, start, Clock::now());
+				}
+			}
+		private:
+			NULL_COPY_AND_ASSIGN(Scope);
+
+			const char* name;
+			StringView detail;
+			// 0 if tracing was off when the scope began
+			uint64 start;
+	};
+};
@@ -87,7 +87,7 @@ bool Util::loadFileWithLinking(StringStream& out, const String& fileName,
 
 	if (file.is_open()) {
 		while (file.good()) {
-			std::getline(file, line);
+			getline(file, line);
 			
 			if (line.find(linkKeyword) == String::npos) {
 				out << line << "\n";
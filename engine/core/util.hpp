@@ -5,6 +5,10 @@
 #include "engine/core/string.hpp"
 #include "engine/core/array-list.hpp"
 
+#if defined(COMPILER_MSVC)
+	#include <intrin.h>
+#endif
+
 namespace Util {
 	void split(ArrayList<String>& elems, const String& s, char delim);
 	ArrayList<String> split(const String& s, char delim);
@@ -31,6 +35,38 @@ namespace Util {
 		return r;
 	}
 
+	// v must not be 0
+	inline uint32 countTrailingZeros(uint32 v) {
+#if defined(COMPILER_MSVC)
+		unsigned long index;
+		_BitScanForward(&index, v);
+
+		return (uint32)index;
+#elif defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+		return (uint32)__builtin_ctz(v);
+#else
+		uint32 n = 0;
+
+		while ((v & 1) == 0) {
+			v >>= 1;
+			++n;
+		}
+
+		return n;
+#endif
+	}
+
+	inline uint32 popCount(uint32 v) {
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+		return (uint32)__builtin_popcount(v);
+#else
+		v = v - ((v >> 1) & 0x55555555u);
+		v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+
+		return (((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+	}
+
 	template <typename T>
 	inline T rotateLeft(T v, int32 shift) {
 		return (v << shift) | (v >> (sizeof(T) * 8 - shift));
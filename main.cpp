@@ -1,63 +1,416 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 
-#include <engine/core/util.hpp>
+#include <engine/core/thread-pool.hpp>
+#include <engine/core/trace.hpp>
 
+#include "shader-cache.hpp"
 #include "shader-parser.hpp"
+#include "shader-preprocessor.hpp"
+#include "shader-source.hpp"
+#include "shader-variants.hpp"
 
-void printLayoutInfo(const ArrayList<ShaderInfo::Layout>& layoutInfo);
+bool loadResponseFile(ArrayList<String>& fileNames, const char* responseFileName);
+void printLayoutInfo(const ShaderInfo& shaderInfo);
+void printVariable(const ShaderInfo& shaderInfo, const ShaderInfo::Variable& var, bool placed);
+void printStats(const ShaderStats& stats);
+
+// writes the trace when main returns, whichever way it does
+struct TraceOutput {
+	const char* fileName = nullptr;
+
+	inline ~TraceOutput() {
+		if (fileName != nullptr) {
+			Trace::stop();
+			Trace::write(fileName);
+		}
+	}
+};
 
 int main(int argc, char** argv) {
-	if (argc != 2) {
-		printf("Usage: %s shader file\n", argv[0]);
+	ArrayList<String> fileNames;
+	uint32 numThreads = 0;
+	ShaderInfo::ScanMode scanMode = ShaderInfo::ScanMode::FULL;
+
+	ShaderDefines defines;
+	bool preprocess = false;
+	ArrayList<String> variantNames;
+
+	const char* cacheDirectory = nullptr;
+	uint64 cacheSize = ShaderCache::DEFAULT_MAX_SIZE;
+
+	bool stats = false;
+	TraceOutput traceOutput;
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			numThreads = (uint32)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--lazy") == 0) {
+			scanMode = ShaderInfo::ScanMode::DECLARATIONS;
+		}
+		else if (std::strncmp(argv[i], "-D", 2) == 0) {
+			const char* definition = argv[i][2] != '\0' ? argv[i] + 2
+					: i + 1 < argc ? argv[++i] : "";
+
+			defines.parseDefinition(definition);
+			preprocess = true;
+		}
+		else if (std::strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+			variantNames.emplace_back(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+			cacheDirectory = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+			cacheSize = (uint64)std::strtoull(argv[++i], nullptr, 10) << 20;
+		}
+		else if (std::strcmp(argv[i], "--stats") == 0) {
+			stats = true;
+		}
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceOutput.fileName = argv[++i];
+		}
+		else if (argv[i][0] == '@') {
+			if (!loadResponseFile(fileNames, argv[i] + 1)) {
+				return 1;
+			}
+		}
+		else {
+			fileNames.emplace_back(argv[i]);
+		}
+	}
+
+	if (fileNames.empty()) {
+		printf("Usage: %s [-j threads] [--lazy] [-D NAME[=VALUE]]... [--variant NAME[=VALUE],...]... "
+				"[--cache-dir directory [--cache-size MiB]] [--stats] [--trace file] shader files... | @response file\n",
+				argv[0]);
+		return 1;
+	}
+
+	if (traceOutput.fileName != nullptr) {
+		Trace::start();
+	}
+
+	if (stats && !ENABLE_STATS) {
+		DEBUG_LOG("Shader Parser", LOG_WARNING, "Built without stats, --stats reports zeros");
+	}
+
+	ShaderCache cache;
+
+	if (cacheDirectory != nullptr && !cache.open(cacheDirectory, cacheSize)) {
 		return 1;
 	}
 
-	StringStream fileStream;
-	Util::loadFileWithLinking(fileStream, argv[1], "#include");
+	ShaderCache* activeCache = cacheDirectory != nullptr ? &cache : nullptr;
+	const ShaderDefines* activeDefines = preprocess ? &defines : nullptr;
+
+	if (!variantNames.empty()) {
+		if (fileNames.size() != 1) {
+			DEBUG_LOG("Shader Parser", LOG_ERROR, "--variant takes a single shader file");
+			return 1;
+		}
+
+		ShaderSource source;
+
+		if (!source.load(fileNames[0], IncludeCache::getGlobal())) {
+			return 1;
+		}
+
+		// every variant starts out with the -D defines
+		ArrayList<ShaderDefines> variants(variantNames.size(), defines);
+
+		for (size_t i = 0; i < variantNames.size(); ++i) {
+			StringView list = variantNames[i];
+
+			while (!list.empty()) {
+				size_t comma = std::min(list.find(','), list.size());
+
+				if (comma > 0) {
+					variants[i].parseDefinition(list.substr(0, comma));
+				}
+
+				list.remove_prefix(std::min(comma + 1, list.size()));
+			}
+		}
+
+		ShaderVariants shaderVariants;
+		bool succeeded = shaderVariants.reflect(source, variants, scanMode);
+
+		for (uint32 i = 0; i < shaderVariants.getVariantCount(); ++i) {
+			printf("VARIANT: %s\n", variantNames[i].c_str());
+
+			if (const ShaderInfo* shaderInfo = shaderVariants.getShaderInfo(i)) {
+				printf("\tINTERFACE: %016llx\n",
+						(unsigned long long)shaderVariants.getInterfaceHash(i));
+				printLayoutInfo(*shaderInfo);
+
+				if (stats) {
+					printStats(shaderInfo->getStats());
+				}
+			}
+			else {
+				puts("\tFAILED");
+			}
+		}
+
+		printf("VARIANTS: %u INTERFACES: %u PARSED: %u\n", shaderVariants.getVariantCount(),
+				shaderVariants.getInterfaceCount(), shaderVariants.getParseCount());
+
+		return succeeded ? 0 : 1;
+	}
+
+	if (fileNames.size() == 1) {
+		ShaderInfo shaderInfo;
+		bool parsed;
+
+		{
+			// the stats are complete once the collect ends, and include the load
+			ShaderStats::Collect collect(shaderInfo.getStats());
+			ShaderSource source;
+
+			if (!source.load(fileNames[0], IncludeCache::getGlobal())) {
+				return 1;
+			}
+
+			if (activeCache != nullptr) {
+				parsed = activeCache->reflect(source, activeDefines, scanMode, shaderInfo);
+			}
+			else {
+				parsed = preprocess ? shaderInfo.parse(source, defines, scanMode)
+						: shaderInfo.parse(source, scanMode);
+			}
+		}
+
+		// whatever parsed around the errors is printed along with them
+		for (const auto& diagnostic : shaderInfo.getDiagnostics()) {
+			ShaderLexer::logDiagnostic(diagnostic);
+		}
+
+		printLayoutInfo(shaderInfo);
+
+		if (stats) {
+			printStats(shaderInfo.getStats());
+		}
+
+		return parsed ? 0 : 1;
+	}
+
+	ThreadPool pool(numThreads);
+	ArrayList<Memory::UniquePointer<ShaderInfo>> results;
+
+	bool succeeded = ShaderInfo::parseBatch(fileNames, results, pool, scanMode, activeDefines,
+			activeCache);
+
+	ShaderStats totalStats;
+
+	// results are indexed by input position, so output does not depend on scheduling
+	for (size_t i = 0; i < fileNames.size(); ++i) {
+		printf("FILE: %s\n", fileNames[i].c_str());
+
+		if (results[i]) {
+			for (const auto& diagnostic : results[i]->getDiagnostics()) {
+				ShaderLexer::logDiagnostic(diagnostic);
+			}
+
+			printLayoutInfo(*results[i]);
+
+			if (stats) {
+				printStats(results[i]->getStats());
+				totalStats.add(results[i]->getStats());
+			}
+		}
+		else {
+			puts("\tFAILED");
+		}
+	}
+
+	// summed over the threads, compare against the wall clock to see the parallel speedup
+	if (stats) {
+		puts("TOTAL:");
+		printStats(totalStats);
+	}
+
+    return succeeded ? 0 : 1;
+}
 
-	ShaderInfo shaderInfo;
+bool loadResponseFile(ArrayList<String>& fileNames, const char* responseFileName) {
+	std::ifstream file(responseFileName);
+
+	if (!file.is_open()) {
+		DEBUG_LOG("File IO", LOG_ERROR, "Failed to open response file: %s", responseFileName);
+		return false;
+	}
+
+	String line;
+
+	while (getline(file, line)) {
+		size_t start = line.find_first_not_of(" \t\r");
+
+		if (start == String::npos) {
+			continue;
+		}
 
-	if (shaderInfo.parse(fileStream)) {
-		printLayoutInfo(shaderInfo.getLayoutInfo());
+		size_t end = line.find_last_not_of(" \t\r");
+		fileNames.push_back(line.substr(start, end - start + 1));
 	}
 
-    return 0;
+	return true;
 }
 
-void printLayoutInfo(const ArrayList<ShaderInfo::Layout>& layoutInfo) {
-	for (const auto& li : layoutInfo) {
+void printLayoutInfo(const ShaderInfo& shaderInfo) {
+	for (const auto& structType : shaderInfo.getStructTypes()) {
+		StringView name = shaderInfo.getString(structType.name);
+
+		puts("STRUCT INFO:");
+		printf("\tSTRUCT NAME: %.*s\n", (int)name.size(), name.data());
+		puts("\tMEMBERS:");
+
+		for (const auto& var : structType.members) {
+			printVariable(shaderInfo, var, false);
+		}
+	}
+
+	// both default to 0 in Vulkan
+	ShaderInfo::Symbol setSymbol = shaderInfo.getInterner().intern("set");
+	ShaderInfo::Symbol bindingSymbol = shaderInfo.getInterner().intern("binding");
+
+	for (const auto& li : shaderInfo.getLayoutInfo()) {
 		puts("LAYOUT INFO:");
 		printf("\tLAYOUT TYPE: %s\n", ShaderInfo::stringifyLayoutType(li.type));
 		
 		puts("\tMEMORY QUALIFIERS:");
 
-		for (const auto& mq : li.memoryQualifiers) {
-			printf("\t\t%s\n", mq.c_str());
+		for (auto mq : li.memoryQualifiers) {
+			StringView qualifier = shaderInfo.getString(mq);
+			printf("\t\t%.*s\n", (int)qualifier.size(), qualifier.data());
+		}
+
+		StringView typeQualifier = shaderInfo.getString(li.typeQualifier);
+		StringView name = shaderInfo.getString(li.name);
+
+		printf("\tTYPE QUALIFIER: %.*s\n", (int)typeQualifier.size(), typeQualifier.data());
+		printf("\tVARIABLE NAME: %.*s\n", (int)name.size(), name.data());
+
+		if (li.isArray && li.arraySize > 0) {
+			printf("\tARRAY SIZE: %d\n", li.arraySize);
+		}
+		else if (li.isArray) {
+			printf("\tARRAY SIZE: %s\n", li.arraySize < 0 ? "unsized" : "constant expression");
+		}
+
+		if (li.descriptorType != ShaderInfo::DescriptorType::NONE) {
+			const ShaderInfo::Option* set = li.findOption(setSymbol);
+			const ShaderInfo::Option* binding = li.findOption(bindingSymbol);
+
+			printf("\tDESCRIPTOR: %s (set %d, binding %d)\n",
+					ShaderInfo::stringifyDescriptorType(li.descriptorType),
+					set != nullptr ? set->value : 0, binding != nullptr ? binding->value : 0);
+		}
+
+		if (li.imageFormat != StringInterner::EMPTY_SYMBOL) {
+			StringView format = shaderInfo.getString(li.imageFormat);
+			printf("\tIMAGE FORMAT: %.*s\n", (int)format.size(), format.data());
+		}
+
+		if (li.defaultValue != StringInterner::EMPTY_SYMBOL) {
+			StringView value = shaderInfo.getString(li.defaultValue);
+			printf("\tDEFAULT VALUE: %.*s\n", (int)value.size(), value.data());
 		}
 
-		printf("\tTYPE QUALIFIER: %s\n", li.typeQualifier.c_str());
-		printf("\tVARIABLE NAME: %s\n", li.name.c_str());
 		puts("\tOPTIONS:");
 
-		for (const auto& pair : li.options) {
-			printf("\t\t%s = %d\n", pair.first.c_str(), pair.second);
+		for (const auto& option : li.options) {
+			StringView optionName = shaderInfo.getString(option.name);
+			printf("\t\t%.*s = %d\n", (int)optionName.size(), optionName.data(), option.value);
+		}
+
+		if (li.memoryLayout != ShaderInfo::MemoryLayout::NONE) {
+			printf("\tMEMORY LAYOUT: %s\n", ShaderInfo::stringifyMemoryLayout(li.memoryLayout));
+			printf("\tBLOCK SIZE: %u\n", li.blockSize);
+
+			if (li.unsizedArrayStride != 0) {
+				printf("\tUNSIZED ARRAY STRIDE: %u\n", li.unsizedArrayStride);
+			}
 		}
 
 		puts("\tVARIABLES:");
 
+		bool hasStructMembers = false;
+
 		for (const auto& var : li.body) {
-			if (var.isArray) {
-				if (var.arraySize == -1) {
-					printf("\t\t%s: %s[]\n", var.name.c_str(), var.typeName.c_str());
-				}
-				else {
-					printf("\t\t%s: %s[%d]\n", var.name.c_str(), var.typeName.c_str(),
-							var.arraySize);
-				}
-			}
-			else {
-				printf("\t\t%s: %s\n", var.name.c_str(), var.typeName.c_str());
+			printVariable(shaderInfo, var, li.memoryLayout != ShaderInfo::MemoryLayout::NONE);
+			hasStructMembers |= shaderInfo.findStructType(var.typeName) != nullptr;
+		}
+
+		if (hasStructMembers && !li.flattenedBody.empty()) {
+			puts("\tFLATTENED VARIABLES:");
+
+			for (const auto& var : li.flattenedBody) {
+				printVariable(shaderInfo, var, true);
 			}
 		}
 	}
+
+	uint32 workgroupSize[3];
+
+	if (shaderInfo.getWorkgroupSize(workgroupSize)) {
+		printf("WORKGROUP SIZE: %u %u %u\n", workgroupSize[0], workgroupSize[1], workgroupSize[2]);
+	}
+}
+
+void printVariable(const ShaderInfo& shaderInfo, const ShaderInfo::Variable& var, bool placed) {
+	StringView varName = shaderInfo.getString(var.name);
+	StringView typeName = shaderInfo.getString(var.typeName);
+
+	printf("\t\t%.*s: %.*s", (int)varName.size(), varName.data(), (int)typeName.size(),
+			typeName.data());
+
+	if (var.isArray) {
+		if (var.arraySize == -1) {
+			printf("[]");
+		}
+		else if (var.arraySize == 0) {
+			printf("[?]");
+		}
+		else {
+			printf("[%d]", var.arraySize);
+		}
+	}
+
+	if (placed) {
+		printf(" (offset %u, size %u, align %u", var.offset, var.size, var.alignment);
+
+		if (var.arrayStride != 0) {
+			printf(", array stride %u", var.arrayStride);
+		}
+
+		if (var.matrixStride != 0) {
+			printf(", matrix stride %u", var.matrixStride);
+		}
+
+		printf(")");
+	}
+
+	puts("");
+}
+
+void printStats(const ShaderStats& stats) {
+	puts("\tSTATS:");
+
+	for (uint32 i = 0; i < ShaderStats::PHASE_COUNT; ++i) {
+		if (stats.phaseTimes[i] != 0) {
+			printf("\t\t%s: %.3f ms\n", ShaderStats::getPhaseName((ShaderStats::Phase)i),
+					stats.phaseTimes[i] / 1e6);
+		}
+	}
+
+	printf("\t\tTotal: %.3f ms\n", stats.getTotalTime() / 1e6);
+	printf("\t\tSource: %llu bytes, %llu tokens\n", (unsigned long long)stats.sourceBytes,
+			(unsigned long long)stats.tokens);
+	printf("\t\tAllocations: %llu (%llu bytes), frees: %llu\n",
+			(unsigned long long)stats.allocations, (unsigned long long)stats.allocatedBytes,
+			(unsigned long long)stats.frees);
 }
@@ -0,0 +1,424 @@
+#include "shader-binary.hpp"
+
+#include "shader-preprocessor.hpp"
+#include "shader-source.hpp"
+#include "shader-stats.hpp"
+
+#include <engine/core/hash.hpp>
+#include <engine/core/hash-map.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+    using Symbol = ShaderInfo::Symbol;
+
+    // Appends the structures of a file to its output. The output buffer moves as it grows,
+    // so everything is addressed by position and references are resolved once both ends
+    // have a position.
+    struct Writer {
+        const ShaderInfo& shaderInfo;
+        ArrayList<char>& output;
+        // position of the characters of every symbol in the string table
+        HashMap<Symbol, uint32> strings;
+
+        Writer(const ShaderInfo& shaderInfo, ArrayList<char>& output);
+
+        // zero filled
+        template <typename T>
+        uint32 allocate(uint32 count);
+
+        template <typename T>
+        inline T& at(uint32 position) { return *(T*)(output.data() + position); }
+
+        void addString(Symbol symbol);
+        void addStrings(const Memory::ArenaArray<ShaderInfo::Variable>& variables);
+
+        void setString(uint32 field, Symbol symbol);
+        // allocates the elements of the array at field, returns the position of the first
+        template <typename T>
+        uint32 setArray(uint32 field, uint32 count);
+
+        void writeVariables(uint32 field, const Memory::ArenaArray<ShaderInfo::Variable>& variables);
+    };
+
+    // Bounds checks of the references of a file. Nothing in a file is trusted before this,
+    // it may be truncated or written by another version.
+    struct Validator {
+        const char* begin;
+        const char* end;
+
+        template <typename T>
+        bool checkArray(const ShaderBinary::Array<T>& array) const;
+        bool checkString(const ShaderBinary::StringRef& str) const;
+        bool checkVariables(const ShaderBinary::Array<ShaderBinary::Variable>& variables) const;
+    };
+
+    Memory::ArenaArray<ShaderInfo::Variable> readVariables(
+            const ShaderBinary::Array<ShaderBinary::Variable>& variables, ShaderInfo& shaderInfo);
+};
+
+uint64 ShaderBinary::hashSource(const ShaderSource& source, const ShaderDefines* defines,
+        uint64 seed) {
+    uint64 hash = seed;
+
+    for (const auto& span : source.getSpans()) {
+        hash = Hash::hash64(span.text.data(), span.text.size(), hash);
+    }
+
+    if (defines == nullptr) {
+        return hash;
+    }
+
+    // the map's order is arbitrary, names are hashed sorted
+    ArrayList<const Pair<const ::String, ::String>*> sorted;
+
+    for (const auto& define : defines->getDefines()) {
+        sorted.push_back(&define);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+        return a->first < b->first;
+    });
+
+    hash = Hash::hash64(&hash, sizeof(hash), sorted.size());
+
+    for (const auto* define : sorted) {
+        // the terminators keep NAME=VALUE pairs from running into each other
+        hash = Hash::hash64(define->first.c_str(), define->first.size() + 1, hash);
+        hash = Hash::hash64(define->second.c_str(), define->second.size() + 1, hash);
+    }
+
+    return hash;
+}
+
+void ShaderBinary::write(const ShaderInfo& shaderInfo, uint64 sourceHash, ArrayList<char>& output) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_SERIALIZE);
+
+    output.clear();
+
+    ::Writer writer(shaderInfo, output);
+    const auto& layouts = shaderInfo.getLayoutInfo();
+    const auto& structTypes = shaderInfo.getStructTypes();
+
+    uint32 header = writer.allocate<Header>(1);
+
+    // the string table goes first, so every other structure can refer to it as it is written
+    for (const auto& layout : layouts) {
+        for (const auto& option : layout.options) {
+            writer.addString(option.name);
+        }
+
+        for (auto qualifier : layout.memoryQualifiers) {
+            writer.addString(qualifier);
+        }
+
+        writer.addString(layout.name);
+        writer.addString(layout.typeQualifier);
+        writer.addString(layout.imageFormat);
+        writer.addString(layout.defaultValue);
+        writer.addStrings(layout.body);
+        writer.addStrings(layout.flattenedBody);
+    }
+
+    for (const auto& structType : structTypes) {
+        writer.addString(structType.name);
+        writer.addStrings(structType.members);
+    }
+
+    uint32 firstLayout = writer.setArray<Layout>(header + offsetof(Header, layouts),
+            (uint32)layouts.size());
+    uint32 firstStructType = writer.setArray<StructType>(header + offsetof(Header, structTypes),
+            (uint32)structTypes.size());
+
+    for (uint32 i = 0; i < layouts.size(); ++i) {
+        const auto& layout = layouts[i];
+        uint32 position = firstLayout + i * sizeof(Layout);
+
+        writer.at<Layout>(position).type = (uint32)layout.type;
+        writer.at<Layout>(position).memoryLayout = (uint32)layout.memoryLayout;
+        writer.at<Layout>(position).descriptorType = (uint32)layout.descriptorType;
+        writer.at<Layout>(position).isArray = layout.isArray;
+        writer.at<Layout>(position).arraySize = layout.arraySize;
+        writer.at<Layout>(position).blockSize = layout.blockSize;
+        writer.at<Layout>(position).unsizedArrayStride = layout.unsizedArrayStride;
+
+        writer.setString(position + offsetof(Layout, name), layout.name);
+        writer.setString(position + offsetof(Layout, typeQualifier), layout.typeQualifier);
+        writer.setString(position + offsetof(Layout, imageFormat), layout.imageFormat);
+        writer.setString(position + offsetof(Layout, defaultValue), layout.defaultValue);
+
+        uint32 firstOption = writer.setArray<Option>(position + offsetof(Layout, options),
+                layout.options.size());
+
+        for (uint32 j = 0; j < layout.options.size(); ++j) {
+            uint32 option = firstOption + j * sizeof(Option);
+
+            writer.setString(option + offsetof(Option, name), layout.options[j].name);
+            writer.at<Option>(option).value = layout.options[j].value;
+        }
+
+        uint32 firstQualifier = writer.setArray<StringRef>(
+                position + offsetof(Layout, memoryQualifiers), layout.memoryQualifiers.size());
+
+        for (uint32 j = 0; j < layout.memoryQualifiers.size(); ++j) {
+            writer.setString(firstQualifier + j * sizeof(StringRef), layout.memoryQualifiers[j]);
+        }
+
+        writer.writeVariables(position + offsetof(Layout, body), layout.body);
+        writer.writeVariables(position + offsetof(Layout, flattenedBody), layout.flattenedBody);
+    }
+
+    for (uint32 i = 0; i < structTypes.size(); ++i) {
+        uint32 position = firstStructType + i * sizeof(StructType);
+
+        writer.setString(position + offsetof(StructType, name), structTypes[i].name);
+        writer.writeVariables(position + offsetof(StructType, members), structTypes[i].members);
+    }
+
+    writer.at<Header>(header).magic = MAGIC;
+    writer.at<Header>(header).version = VERSION;
+    writer.at<Header>(header).sourceHash = sourceHash;
+    writer.at<Header>(header).fileSize = (uint32)output.size();
+    writer.at<Header>(header).parserVersion = PARSER_VERSION;
+}
+
+const ShaderBinary::Header* ShaderBinary::open(const void* data, uintptr size) {
+    if (((uintptr)data & (alignof(Header) - 1)) != 0 || size < sizeof(Header)) {
+        return nullptr;
+    }
+
+    const Header* header = (const Header*)data;
+
+    // files of other versions are expected after an upgrade and simply not used
+    if (header->magic != MAGIC || header->version != VERSION || header->fileSize != size) {
+        return nullptr;
+    }
+
+    ::Validator validator = {(const char*)data, (const char*)data + size};
+    bool valid = validator.checkArray(header->layouts) && validator.checkArray(header->structTypes);
+
+    for (uint32 i = 0; valid && i < header->layouts.size(); ++i) {
+        const auto& layout = header->layouts[i];
+
+        valid = layout.type <= (uint32)ShaderInfo::LayoutType::INVALID
+                && layout.memoryLayout <= (uint32)ShaderInfo::MemoryLayout::NONE
+                && layout.descriptorType <= (uint32)ShaderInfo::DescriptorType::NONE
+                && validator.checkArray(layout.options)
+                && validator.checkArray(layout.memoryQualifiers)
+                && validator.checkString(layout.name)
+                && validator.checkString(layout.typeQualifier)
+                && validator.checkString(layout.imageFormat)
+                && validator.checkString(layout.defaultValue)
+                && validator.checkVariables(layout.body)
+                && validator.checkVariables(layout.flattenedBody);
+
+        for (uint32 j = 0; valid && j < layout.options.size(); ++j) {
+            valid = validator.checkString(layout.options[j].name);
+        }
+
+        for (uint32 j = 0; valid && j < layout.memoryQualifiers.size(); ++j) {
+            valid = validator.checkString(layout.memoryQualifiers[j]);
+        }
+    }
+
+    for (uint32 i = 0; valid && i < header->structTypes.size(); ++i) {
+        valid = validator.checkString(header->structTypes[i].name)
+                && validator.checkVariables(header->structTypes[i].members);
+    }
+
+    if (!valid) {
+        DEBUG_LOG("Shader Binary", LOG_WARNING, "Corrupt reflection file");
+        return nullptr;
+    }
+
+    return header;
+}
+
+void ShaderBinary::read(const Header& header, ShaderInfo& shaderInfo) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_SERIALIZE);
+
+    StringInterner& interner = shaderInfo.getInterner();
+    Memory::Arena& arena = shaderInfo.getArena();
+
+    for (const auto& structType : header.structTypes) {
+        shaderInfo.getStructTypes().push_back({interner.intern(structType.name.get()),
+                ::readVariables(structType.members, shaderInfo)});
+    }
+
+    for (const auto& layout : header.layouts) {
+        ShaderInfo::Layout li;
+        li.type = (ShaderInfo::LayoutType)layout.type;
+        li.memoryLayout = (ShaderInfo::MemoryLayout)layout.memoryLayout;
+
+        if (!layout.options.empty()) {
+            auto* options = arena.allocate<ShaderInfo::Option>(layout.options.size());
+
+            for (uint32 i = 0; i < layout.options.size(); ++i) {
+                options[i] = {interner.intern(layout.options[i].name.get()), layout.options[i].value};
+            }
+
+            li.options = Memory::ArenaArray<ShaderInfo::Option>(options, layout.options.size());
+        }
+
+        if (!layout.memoryQualifiers.empty()) {
+            auto* qualifiers = arena.allocate<Symbol>(layout.memoryQualifiers.size());
+
+            for (uint32 i = 0; i < layout.memoryQualifiers.size(); ++i) {
+                qualifiers[i] = interner.intern(layout.memoryQualifiers[i].get());
+            }
+
+            li.memoryQualifiers = Memory::ArenaArray<Symbol>(qualifiers,
+                    layout.memoryQualifiers.size());
+        }
+
+        li.name = interner.intern(layout.name.get());
+        li.typeQualifier = interner.intern(layout.typeQualifier.get());
+        li.descriptorType = (ShaderInfo::DescriptorType)layout.descriptorType;
+        li.imageFormat = interner.intern(layout.imageFormat.get());
+        li.isArray = layout.isArray != 0;
+        li.arraySize = layout.arraySize;
+        li.defaultValue = interner.intern(layout.defaultValue.get());
+        li.body = ::readVariables(layout.body, shaderInfo);
+        li.flattenedBody = ::readVariables(layout.flattenedBody, shaderInfo);
+        li.blockSize = layout.blockSize;
+        li.unsizedArrayStride = layout.unsizedArrayStride;
+
+        shaderInfo.getLayoutInfo().push_back(li);
+    }
+}
+
+namespace {
+    Writer::Writer(const ShaderInfo& shaderInfo, ArrayList<char>& output)
+            : shaderInfo(shaderInfo)
+            , output(output) {}
+
+    template <typename T>
+    uint32 Writer::allocate(uint32 count) {
+        uint32 position = (uint32)(output.size() + alignof(T) - 1) & ~(uint32)(alignof(T) - 1);
+        output.resize(position + sizeof(T) * count, 0);
+
+        return position;
+    }
+
+    void Writer::addString(Symbol symbol) {
+        if (strings.count(symbol) != 0) {
+            return;
+        }
+
+        StringView str = shaderInfo.getString(symbol);
+
+        strings[symbol] = (uint32)output.size();
+        output.insert(output.end(), str.begin(), str.end());
+        output.push_back('\0');
+    }
+
+    void Writer::addStrings(const Memory::ArenaArray<ShaderInfo::Variable>& variables) {
+        for (const auto& var : variables) {
+            addString(var.typeName);
+            addString(var.name);
+        }
+    }
+
+    void Writer::setString(uint32 field, Symbol symbol) {
+        auto& str = at<ShaderBinary::StringRef>(field);
+        str.offset = (int32)(strings[symbol] - field);
+        str.length = (uint32)shaderInfo.getString(symbol).size();
+    }
+
+    template <typename T>
+    uint32 Writer::setArray(uint32 field, uint32 count) {
+        uint32 first = allocate<T>(count);
+        auto& array = at<ShaderBinary::Array<T>>(field);
+
+        array.offset = count != 0 ? (int32)(first - field) : 0;
+        array.count = count;
+
+        return first;
+    }
+
+    void Writer::writeVariables(uint32 field,
+            const Memory::ArenaArray<ShaderInfo::Variable>& variables) {
+        uint32 first = setArray<ShaderBinary::Variable>(field, variables.size());
+
+        for (uint32 i = 0; i < variables.size(); ++i) {
+            const auto& var = variables[i];
+            uint32 position = first + i * sizeof(ShaderBinary::Variable);
+
+            setString(position + offsetof(ShaderBinary::Variable, typeName), var.typeName);
+            setString(position + offsetof(ShaderBinary::Variable, name), var.name);
+
+            auto& out = at<ShaderBinary::Variable>(position);
+            out.isArray = var.isArray;
+            out.arraySize = var.arraySize;
+            out.offset = var.offset;
+            out.size = var.size;
+            out.alignment = var.alignment;
+            out.arrayStride = var.arrayStride;
+            out.matrixStride = var.matrixStride;
+        }
+    }
+
+    template <typename T>
+    bool Validator::checkArray(const ShaderBinary::Array<T>& array) const {
+        if (array.count == 0) {
+            return true;
+        }
+
+        const char* first = (const char*)array.begin();
+
+        return first >= begin && first < end && ((uintptr)first & (alignof(T) - 1)) == 0
+                && (uintptr)(end - first) / sizeof(T) >= array.count;
+    }
+
+    bool Validator::checkString(const ShaderBinary::StringRef& str) const {
+        const char* first = str.c_str();
+
+        return first >= begin && first < end && (uintptr)(end - first) > str.length
+                && first[str.length] == '\0';
+    }
+
+    bool Validator::checkVariables(
+            const ShaderBinary::Array<ShaderBinary::Variable>& variables) const {
+        if (!checkArray(variables)) {
+            return false;
+        }
+
+        for (const auto& var : variables) {
+            if (!checkString(var.typeName) || !checkString(var.name)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    Memory::ArenaArray<ShaderInfo::Variable> readVariables(
+            const ShaderBinary::Array<ShaderBinary::Variable>& variables, ShaderInfo& shaderInfo) {
+        if (variables.empty()) {
+            return Memory::ArenaArray<ShaderInfo::Variable>();
+        }
+
+        StringInterner& interner = shaderInfo.getInterner();
+        auto* out = shaderInfo.getArena().allocate<ShaderInfo::Variable>(variables.size());
+
+        for (uint32 i = 0; i < variables.size(); ++i) {
+            const auto& var = variables[i];
+            StringView name = var.name.get();
+
+            out[i].typeName = interner.intern(var.typeName.get());
+            // the member paths of flattened bodies stay out of the interner like when parsed
+            out[i].name = name.find('.') != StringView::npos ? shaderInfo.internPath(name)
+                    : interner.intern(name);
+            out[i].isArray = var.isArray != 0;
+            out[i].arraySize = var.arraySize;
+            out[i].offset = var.offset;
+            out[i].size = var.size;
+            out[i].alignment = var.alignment;
+            out[i].arrayStride = var.arrayStride;
+            out[i].matrixStride = var.matrixStride;
+        }
+
+        return Memory::ArenaArray<ShaderInfo::Variable>(out, variables.size());
+    }
+};
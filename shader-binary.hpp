@@ -0,0 +1,126 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+
+#include "shader-parser.hpp"
+
+class ShaderDefines;
+class ShaderSource;
+
+// Binary form of a ShaderInfo that is read in place. Every reference inside the file is a
+// signed byte offset from the reference itself and every string points into a string table
+// stored once per file, so a mapped file can be walked as is, with no parsing, fixups or
+// allocations. Values are stored little endian with their natural alignment and the file
+// must be loaded at an 8 byte aligned address, which mappings always are.
+namespace ShaderBinary {
+    constexpr uint32 MAGIC = 0x4c464552; // "REFL"
+    // bumped on every change to the structures below
+    constexpr uint32 VERSION = 3;
+    // bumped whenever the parser reflects a source differently, which leaves the files of
+    // older parsers stale though their format is still readable
+    constexpr uint32 PARSER_VERSION = 1;
+
+    template <typename T>
+    struct Array {
+        int32 offset; // from this field to the first element
+        uint32 count;
+
+        inline const T* begin() const { return (const T*)((const char*)this + offset); }
+        inline const T* end() const { return begin() + count; }
+
+        inline const T& operator[](uint32 index) const { return begin()[index]; }
+
+        inline uint32 size() const { return count; }
+        inline bool empty() const { return count == 0; }
+    };
+
+    // null terminated inside the string table
+    struct StringRef {
+        int32 offset; // from this field to the first character
+        uint32 length;
+
+        inline const char* c_str() const { return (const char*)this + offset; }
+        inline StringView get() const { return StringView(c_str(), length); }
+    };
+
+    struct Variable {
+        StringRef typeName;
+        StringRef name;
+        uint32 isArray;
+        int32 arraySize;
+
+        uint32 offset;
+        uint32 size;
+        uint32 alignment;
+        uint32 arrayStride;
+        uint32 matrixStride;
+    };
+
+    struct Option {
+        StringRef name;
+        int32 value;
+    };
+
+    struct Layout {
+        uint32 type;         // ShaderInfo::LayoutType
+        uint32 memoryLayout; // ShaderInfo::MemoryLayout
+
+        Array<Option> options;
+        Array<StringRef> memoryQualifiers;
+        StringRef name;
+        StringRef typeQualifier;
+
+        uint32 descriptorType; // ShaderInfo::DescriptorType
+        StringRef imageFormat;
+        uint32 isArray;
+        int32 arraySize;
+        StringRef defaultValue;
+
+        Array<Variable> body;
+        Array<Variable> flattenedBody;
+        uint32 blockSize;
+        uint32 unsizedArrayStride;
+    };
+
+    struct StructType {
+        StringRef name;
+        Array<Variable> members;
+    };
+
+    struct Header {
+        uint32 magic;
+        uint32 version;
+        // hash of the source the reflection was made from, see hashSource()
+        uint64 sourceHash;
+        uint32 fileSize;
+        uint32 parserVersion;
+
+        Array<Layout> layouts;
+        Array<StructType> structTypes;
+    };
+
+    // hash of the linked source and the defines it is preprocessed with, which is what
+    // decides the reflection of a shader. Different seeds give independent hashes.
+    uint64 hashSource(const ShaderSource& source, const ShaderDefines* defines = nullptr,
+            uint64 seed = 0);
+
+    // replaces output with the binary form of shaderInfo
+    void write(const ShaderInfo& shaderInfo, uint64 sourceHash, ArrayList<char>& output);
+
+    // Header of the file in data, or null if it is not a valid file of this version. Every
+    // offset is bounds checked in a single pass over the file, nothing is allocated.
+    const Header* open(const void* data, uintptr size);
+
+    // stale files are the ones whose sourceHash differs from hashSource() of the current source
+    // or that an older parser wrote
+    inline bool isCurrent(const Header& header, uint64 sourceHash) {
+        return header.sourceHash == sourceHash && header.parserVersion == PARSER_VERSION;
+    }
+
+    // Copies the reflection of a file into an empty shaderInfo, interning its strings, for
+    // code that wants a ShaderInfo rather than reading the file in place
+    void read(const Header& header, ShaderInfo& shaderInfo);
+};
@@ -0,0 +1,211 @@
+#include "shader-cache.hpp"
+
+#include "shader-binary.hpp"
+#include "shader-source.hpp"
+#include "shader-stats.hpp"
+
+#include <engine/core/memory-mapped-file.hpp>
+#include <engine/core/trace.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+    constexpr const char* ENTRY_EXTENSION = ".refl";
+    constexpr const char* TEMP_EXTENSION = ".tmp";
+
+    // temporary files this old were left behind by a process that died while writing
+    constexpr auto ABANDONED_TEMP_AGE = std::chrono::hours(1);
+
+    // seed of the second half of a key
+    constexpr uint64 HIGH_KEY_SEED = 0x9e3779b97f4a7c15ull;
+};
+
+bool ShaderCache::open(const String& directory, uint64 maxSize) {
+    std::error_code error;
+    std::filesystem::create_directories(directory.c_str(), error);
+
+    if (error || !std::filesystem::is_directory(directory.c_str(), error)) {
+        DEBUG_LOG("Shader Cache", LOG_ERROR, "Failed to open cache directory: %s",
+                directory.c_str());
+        return false;
+    }
+
+    this->directory = directory;
+    this->maxSize = maxSize;
+    instanceID = ((uint64)std::random_device()() << 32) | std::random_device()();
+
+    uint64 total = 0;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory.c_str(), error)) {
+        if (entry.path().extension() == ::ENTRY_EXTENSION) {
+            total += entry.file_size(error);
+        }
+    }
+
+    usage.store(total);
+
+    return true;
+}
+
+ShaderCache::Key ShaderCache::getKey(const ShaderSource& source, const ShaderDefines* defines) {
+    return {ShaderBinary::hashSource(source, defines),
+            ShaderBinary::hashSource(source, defines, ::HIGH_KEY_SEED)};
+}
+
+bool ShaderCache::load(const Key& key, ShaderInfo& shaderInfo) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_SERIALIZE);
+    Trace::Scope scope("Serialize", "cache load");
+
+    String path = getEntryPath(key);
+    MemoryMappedFile file;
+    std::error_code error;
+
+    // a missing entry is the common case and not worth the log line of a failed open
+    if (!std::filesystem::exists(path.c_str(), error) || !file.open(path)) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const ShaderBinary::Header* header = ShaderBinary::open(file.getData(), file.getSize());
+
+    if (header == nullptr || !ShaderBinary::isCurrent(*header, key.low)) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ShaderBinary::read(*header, shaderInfo);
+    hits.fetch_add(1, std::memory_order_relaxed);
+
+    // recently used entries are the last to be evicted, failing to mark one is harmless
+    std::filesystem::last_write_time(path.c_str(), std::filesystem::file_time_type::clock::now(),
+            error);
+
+    return true;
+}
+
+void ShaderCache::store(const Key& key, const ShaderInfo& shaderInfo) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_SERIALIZE);
+    Trace::Scope scope("Serialize", "cache store");
+
+    ArrayList<char> data;
+    ShaderBinary::write(shaderInfo, key.low, data);
+
+    char tempName[64];
+    snprintf(tempName, sizeof(tempName), "/%016llx-%u%s", (unsigned long long)instanceID,
+            tempCounter.fetch_add(1, std::memory_order_relaxed), ::TEMP_EXTENSION);
+
+    String tempPath = directory + tempName;
+
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+
+        if (!file.write(data.data(), data.size()) || !file.flush()) {
+            DEBUG_LOG("Shader Cache", LOG_WARNING, "Failed to write cache entry: %s",
+                    tempPath.c_str());
+            std::error_code error;
+            std::filesystem::remove(tempPath.c_str(), error);
+
+            return;
+        }
+    }
+
+    // replaces an entry another process may have stored meanwhile, both hold the same data
+    std::error_code error;
+    std::filesystem::rename(tempPath.c_str(), getEntryPath(key).c_str(), error);
+
+    if (error) {
+        std::filesystem::remove(tempPath.c_str(), error);
+        return;
+    }
+
+    if (usage.fetch_add(data.size()) + data.size() > maxSize) {
+        evict();
+    }
+}
+
+bool ShaderCache::reflect(const ShaderSource& source, const ShaderDefines* defines,
+        ShaderInfo::ScanMode mode, ShaderInfo& shaderInfo) {
+    ShaderStats::Collect collect(shaderInfo.getStats());
+    Key key = getKey(source, defines);
+
+    if (load(key, shaderInfo)) {
+        return true;
+    }
+
+    if (!(defines != nullptr ? shaderInfo.parse(source, *defines, mode)
+            : shaderInfo.parse(source, mode))) {
+        return false;
+    }
+
+    // entries hold no diagnostics, so a reflection with warnings is parsed again each time
+    // rather than hit without them
+    if (shaderInfo.getDiagnostics().empty()) {
+        store(key, shaderInfo);
+    }
+
+    return true;
+}
+
+String ShaderCache::getEntryPath(const Key& key) const {
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx%016llx%s", (unsigned long long)key.high,
+            (unsigned long long)key.low, ::ENTRY_EXTENSION);
+
+    return directory + name;
+}
+
+void ShaderCache::evict() {
+    std::lock_guard<std::mutex> lock(evictMutex);
+
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastUse;
+        uint64 size;
+    };
+
+    ArrayList<Entry> entries;
+    uint64 total = 0;
+    auto now = std::filesystem::file_time_type::clock::now();
+    std::error_code error;
+
+    for (const auto& file : std::filesystem::directory_iterator(directory.c_str(), error)) {
+        auto extension = file.path().extension();
+        auto lastUse = file.last_write_time(error);
+
+        if (error) {
+            continue;
+        }
+
+        if (extension == ::TEMP_EXTENSION && now - lastUse > ::ABANDONED_TEMP_AGE) {
+            std::filesystem::remove(file.path(), error);
+        }
+        else if (extension == ::ENTRY_EXTENSION) {
+            uint64 size = file.file_size(error);
+
+            if (!error) {
+                entries.push_back({file.path(), lastUse, size});
+                total += size;
+            }
+        }
+    }
+
+    // down to three quarters of the limit, so the next few stores don't rescan
+    uint64 target = maxSize / 4 * 3;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.lastUse < b.lastUse;
+    });
+
+    // an entry another process removed first or still has mapped is skipped, mappings of
+    // removed entries stay valid
+    for (size_t i = 0; i < entries.size() && total > target; ++i) {
+        if (std::filesystem::remove(entries[i].path, error)) {
+            total -= entries[i].size;
+        }
+    }
+
+    usage.store(total);
+}
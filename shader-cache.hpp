@@ -0,0 +1,66 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+
+#include "shader-parser.hpp"
+
+#include <atomic>
+#include <mutex>
+
+class ShaderDefines;
+class ShaderSource;
+
+// Content addressed on-disk store of reflection results in the ShaderBinary format, keyed by
+// a 128 bit hash of the linked source and its defines, so a hit skips lexing and parsing
+// entirely. Entries are written to a temporary file and renamed into place, which lets any
+// number of processes share a directory: a reader sees a whole entry or none. The directory
+// is kept under a size limit by removing the least recently used entries, a hit refreshes
+// the modification time of its entry.
+class ShaderCache {
+    public:
+        static constexpr uint64 DEFAULT_MAX_SIZE = 64ull << 20;
+
+        struct Key {
+            uint64 low;
+            uint64 high;
+        };
+
+        ShaderCache() = default;
+
+        // creates directory if needed
+        bool open(const String& directory, uint64 maxSize = DEFAULT_MAX_SIZE);
+
+        // defines is null for a source that is not preprocessed
+        static Key getKey(const ShaderSource& source, const ShaderDefines* defines);
+
+        // fills an empty shaderInfo from the entry of key, false on a miss
+        bool load(const Key& key, ShaderInfo& shaderInfo);
+        void store(const Key& key, const ShaderInfo& shaderInfo);
+
+        // loads the reflection of source, or parses it on a miss and stores the result
+        bool reflect(const ShaderSource& source, const ShaderDefines* defines,
+                ShaderInfo::ScanMode mode, ShaderInfo& shaderInfo);
+
+        inline uint32 getHitCount() const { return hits.load(); }
+        inline uint32 getMissCount() const { return misses.load(); }
+    private:
+        NULL_COPY_AND_ASSIGN(ShaderCache);
+
+        String getEntryPath(const Key& key) const;
+        // removes the oldest entries until the directory is well under the size limit
+        void evict();
+
+        String directory;
+        uint64 maxSize = DEFAULT_MAX_SIZE;
+        // unique per instance, keeps temporary files of concurrent processes apart
+        uint64 instanceID = 0;
+
+        // estimate of the directory size, entries of other processes are only seen on evict()
+        std::atomic<uint64> usage{0};
+        std::atomic<uint32> tempCounter{0};
+        std::atomic<uint32> hits{0};
+        std::atomic<uint32> misses{0};
+
+        std::mutex evictMutex;
+};
@@ -0,0 +1,354 @@
+#include "shader-lexer-scan.hpp"
+
+#include <engine/core/util.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+    #define SHADER_LEXER_SSE2
+    #include <emmintrin.h>
+
+    #if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+        #define SHADER_LEXER_AVX2
+        #include <immintrin.h>
+    #endif
+#endif
+
+namespace {
+    FORCEINLINE bool isSpace(char c) {
+        return c == ' ' || (uint8)(c - '\t') <= '\r' - '\t';
+    }
+
+    FORCEINLINE bool isIdentifierChar(char c) {
+        return (uint8)((c | 0x20) - 'a') < 26 || (uint8)(c - '0') < 10 || c == '_';
+    }
+
+    const char* skipWhitespaceScalar(const char* c, const char* end, uint32& line) {
+        for (; c != end && isSpace(*c); ++c) {
+            line += *c == '\n';
+        }
+
+        return c;
+    }
+
+    const char* skipIdentifierScalar(const char* c, const char* end) {
+        while (c != end && isIdentifierChar(*c)) {
+            ++c;
+        }
+
+        return c;
+    }
+
+    const char* skipNumberScalar(const char* c, const char* end) {
+        while (c != end && (isIdentifierChar(*c) || *c == '.')) {
+            ++c;
+        }
+
+        return c;
+    }
+
+    const char* skipBlockCommentScalar(const char* c, const char* end, uint32& line) {
+        for (; c != end; ++c) {
+            if (*c == '*' && c + 1 != end && c[1] == '/') {
+                return c + 2;
+            }
+
+            line += *c == '\n';
+        }
+
+        return end;
+    }
+
+    FORCEINLINE bool isStructural(char c) {
+        return c == '{' || c == '}' || c == ';' || c == '/' || c == '#';
+    }
+
+    const char* skipToStructuralScalar(const char* c, const char* end, uint32& line) {
+        for (; c != end && !isStructural(*c); ++c) {
+            line += *c == '\n';
+        }
+
+        return c;
+    }
+
+#ifdef SHADER_LEXER_SSE2
+    // bytes v with lo <= v <= lo + range, as unsigned compare through min
+    FORCEINLINE __m128i inRange(__m128i v, char lo, char range) {
+        __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(range)), t);
+    }
+
+    FORCEINLINE __m128i whitespaceMask(__m128i v) {
+        return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', '\r' - '\t'));
+    }
+
+    FORCEINLINE __m128i identifierMask(__m128i v) {
+        __m128i alpha = inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z' - 'a');
+        __m128i digit = inRange(v, '0', 9);
+
+        return _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    }
+
+    const char* skipWhitespaceSSE2(const char* c, const char* end, uint32& line) {
+        while (end - c >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)c);
+
+            uint32 stop = ~(uint32)_mm_movemask_epi8(whitespaceMask(v)) & 0xFFFFu;
+            uint32 newlines = (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+            if (stop != 0) {
+                uint32 n = Util::countTrailingZeros(stop);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n;
+            }
+
+            line += Util::popCount(newlines);
+            c += 16;
+        }
+
+        return skipWhitespaceScalar(c, end, line);
+    }
+
+    const char* skipIdentifierSSE2(const char* c, const char* end) {
+        while (end - c >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)c);
+            uint32 stop = ~(uint32)_mm_movemask_epi8(identifierMask(v)) & 0xFFFFu;
+
+            if (stop != 0) {
+                return c + Util::countTrailingZeros(stop);
+            }
+
+            c += 16;
+        }
+
+        return skipIdentifierScalar(c, end);
+    }
+
+    const char* skipNumberSSE2(const char* c, const char* end) {
+        while (end - c >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)c);
+            __m128i mask = _mm_or_si128(identifierMask(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+            uint32 stop = ~(uint32)_mm_movemask_epi8(mask) & 0xFFFFu;
+
+            if (stop != 0) {
+                return c + Util::countTrailingZeros(stop);
+            }
+
+            c += 16;
+        }
+
+        return skipNumberScalar(c, end);
+    }
+
+    const char* skipBlockCommentSSE2(const char* c, const char* end, uint32& line) {
+        // the second load reads one byte ahead to pair every * with the byte after it
+        while (end - c >= 17) {
+            __m128i v = _mm_loadu_si128((const __m128i*)c);
+            __m128i next = _mm_loadu_si128((const __m128i*)(c + 1));
+
+            uint32 close = (uint32)_mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8('*')), _mm_cmpeq_epi8(next, _mm_set1_epi8('/'))));
+            uint32 newlines = (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+            if (close != 0) {
+                uint32 n = Util::countTrailingZeros(close);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n + 2;
+            }
+
+            line += Util::popCount(newlines);
+            c += 16;
+        }
+
+        return skipBlockCommentScalar(c, end, line);
+    }
+
+    const char* skipToStructuralSSE2(const char* c, const char* end, uint32& line) {
+        while (end - c >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)c);
+            __m128i braces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')),
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+            __m128i other = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(';')),
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))), _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+
+            uint32 stop = (uint32)_mm_movemask_epi8(_mm_or_si128(braces, other));
+            uint32 newlines = (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+            if (stop != 0) {
+                uint32 n = Util::countTrailingZeros(stop);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n;
+            }
+
+            line += Util::popCount(newlines);
+            c += 16;
+        }
+
+        return skipToStructuralScalar(c, end, line);
+    }
+
+    const ShaderLexer::Scanner SSE2_SCANNER = {"sse2", skipWhitespaceSSE2, skipIdentifierSSE2,
+            skipNumberSSE2, skipBlockCommentSSE2, skipToStructuralSSE2};
+#endif
+
+#ifdef SHADER_LEXER_AVX2
+    #define AVX2_FUNCTION __attribute__((target("avx2")))
+
+    AVX2_FUNCTION inline __m256i inRange256(__m256i v, char lo, char range) {
+        __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(range)), t);
+    }
+
+    AVX2_FUNCTION inline __m256i identifierMask256(__m256i v) {
+        __m256i alpha = inRange256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a');
+        __m256i digit = inRange256(v, '0', 9);
+
+        return _mm256_or_si256(_mm256_or_si256(alpha, digit),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    }
+
+    AVX2_FUNCTION const char* skipWhitespaceAVX2(const char* c, const char* end, uint32& line) {
+        while (end - c >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)c);
+            __m256i mask = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                    inRange256(v, '\t', '\r' - '\t'));
+
+            uint32 stop = ~(uint32)_mm256_movemask_epi8(mask);
+            uint32 newlines = (uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+                    _mm256_set1_epi8('\n')));
+
+            if (stop != 0) {
+                uint32 n = Util::countTrailingZeros(stop);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n;
+            }
+
+            line += Util::popCount(newlines);
+            c += 32;
+        }
+
+        return skipWhitespaceSSE2(c, end, line);
+    }
+
+    AVX2_FUNCTION const char* skipIdentifierAVX2(const char* c, const char* end) {
+        while (end - c >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)c);
+            uint32 stop = ~(uint32)_mm256_movemask_epi8(identifierMask256(v));
+
+            if (stop != 0) {
+                return c + Util::countTrailingZeros(stop);
+            }
+
+            c += 32;
+        }
+
+        return skipIdentifierSSE2(c, end);
+    }
+
+    AVX2_FUNCTION const char* skipNumberAVX2(const char* c, const char* end) {
+        while (end - c >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)c);
+            __m256i mask = _mm256_or_si256(identifierMask256(v),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+            uint32 stop = ~(uint32)_mm256_movemask_epi8(mask);
+
+            if (stop != 0) {
+                return c + Util::countTrailingZeros(stop);
+            }
+
+            c += 32;
+        }
+
+        return skipNumberSSE2(c, end);
+    }
+
+    AVX2_FUNCTION const char* skipBlockCommentAVX2(const char* c, const char* end, uint32& line) {
+        while (end - c >= 33) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)c);
+            __m256i next = _mm256_loadu_si256((const __m256i*)(c + 1));
+
+            uint32 close = (uint32)_mm256_movemask_epi8(_mm256_and_si256(
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                    _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/'))));
+            uint32 newlines = (uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+                    _mm256_set1_epi8('\n')));
+
+            if (close != 0) {
+                uint32 n = Util::countTrailingZeros(close);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n + 2;
+            }
+
+            line += Util::popCount(newlines);
+            c += 32;
+        }
+
+        return skipBlockCommentSSE2(c, end, line);
+    }
+
+    AVX2_FUNCTION const char* skipToStructuralAVX2(const char* c, const char* end, uint32& line) {
+        while (end - c >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)c);
+            __m256i braces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+            __m256i other = _mm256_or_si256(_mm256_or_si256(
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))),
+                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+
+            uint32 stop = (uint32)_mm256_movemask_epi8(_mm256_or_si256(braces, other));
+            uint32 newlines = (uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+                    _mm256_set1_epi8('\n')));
+
+            if (stop != 0) {
+                uint32 n = Util::countTrailingZeros(stop);
+                line += Util::popCount(newlines & ((1u << n) - 1));
+
+                return c + n;
+            }
+
+            line += Util::popCount(newlines);
+            c += 32;
+        }
+
+        return skipToStructuralSSE2(c, end, line);
+    }
+
+    #undef AVX2_FUNCTION
+
+    const ShaderLexer::Scanner AVX2_SCANNER = {"avx2", skipWhitespaceAVX2, skipIdentifierAVX2,
+            skipNumberAVX2, skipBlockCommentAVX2, skipToStructuralAVX2};
+#endif
+
+    const ShaderLexer::Scanner SCALAR_SCANNER = {"scalar", skipWhitespaceScalar,
+            skipIdentifierScalar, skipNumberScalar, skipBlockCommentScalar,
+            skipToStructuralScalar};
+
+    const ShaderLexer::Scanner& selectScanner() {
+#ifdef SHADER_LEXER_AVX2
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            return AVX2_SCANNER;
+        }
+#endif
+
+#ifdef SHADER_LEXER_SSE2
+        return SSE2_SCANNER;
+#else
+        return SCALAR_SCANNER;
+#endif
+    }
+};
+
+const ShaderLexer::Scanner& ShaderLexer::getScanner() {
+    static const Scanner& scanner = ::selectScanner();
+    return scanner;
+}
+
+const ShaderLexer::Scanner& ShaderLexer::getScalarScanner() {
+    return ::SCALAR_SCANNER;
+}
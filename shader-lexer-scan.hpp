@@ -0,0 +1,24 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+
+namespace ShaderLexer {
+    // Character class scanners the lexer uses to skip over runs of bytes. Every function
+    // returns the first position at or after c that is not part of the run, never past end,
+    // and adds the newlines it skipped to line where the run can contain any.
+    struct Scanner {
+        const char* name;
+
+        const char* (*skipWhitespace)(const char* c, const char* end, uint32& line);
+        const char* (*skipIdentifier)(const char* c, const char* end);
+        const char* (*skipNumber)(const char* c, const char* end);
+        // c points just past the opening /*, returns the position after the closing */
+        const char* (*skipBlockComment)(const char* c, const char* end, uint32& line);
+        // stops at the next character that can change statement or brace structure: { } ; / #
+        const char* (*skipToStructural)(const char* c, const char* end, uint32& line);
+    };
+
+    // the widest implementation the running CPU supports, chosen on first use
+    const Scanner& getScanner();
+    const Scanner& getScalarScanner();
+};
@@ -0,0 +1,734 @@
+#include "shader-lexer.hpp"
+#include "shader-lexer-scan.hpp"
+#include "shader-stats.hpp"
+
+#include <engine/core/trace.hpp>
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+    using Token = ShaderLexer::Token;
+
+    struct Keyword {
+        const char* name;
+        Token::TokenType type;
+    };
+
+    // https://www.khronos.org/registry/OpenGL/specs/gl/GLSLangSpec.4.60.pdf section 3.6, plus
+    // the GL_KHR_vulkan_glsl texture, sampler and subpass types
+    constexpr Keyword KEYWORDS[] = {
+        {"layout", Token::TYPE_LAYOUT},
+        {"in", Token::TYPE_IN},
+        {"out", Token::TYPE_OUT},
+        {"uniform", Token::TYPE_UNIFORM},
+        {"buffer", Token::TYPE_BUFFER},
+
+        // https://www.khronos.org/opengl/wiki/Type_Qualifier_(GLSL)#Memory_qualifiers
+        {"coherent", Token::TYPE_MEMORY_QUALIFIER},
+        {"volatile", Token::TYPE_MEMORY_QUALIFIER},
+        {"restrict", Token::TYPE_MEMORY_QUALIFIER},
+        {"readonly", Token::TYPE_MEMORY_QUALIFIER},
+        {"writeonly", Token::TYPE_MEMORY_QUALIFIER},
+
+        {"const", Token::TYPE_QUALIFIER},
+        {"shared", Token::TYPE_QUALIFIER},
+        {"attribute", Token::TYPE_QUALIFIER},
+        {"varying", Token::TYPE_QUALIFIER},
+        {"inout", Token::TYPE_QUALIFIER},
+        {"centroid", Token::TYPE_QUALIFIER},
+        {"flat", Token::TYPE_QUALIFIER},
+        {"smooth", Token::TYPE_QUALIFIER},
+        {"noperspective", Token::TYPE_QUALIFIER},
+        {"patch", Token::TYPE_QUALIFIER},
+        {"sample", Token::TYPE_QUALIFIER},
+        {"invariant", Token::TYPE_QUALIFIER},
+        {"precise", Token::TYPE_QUALIFIER},
+        {"subroutine", Token::TYPE_QUALIFIER},
+        {"lowp", Token::TYPE_QUALIFIER},
+        {"mediump", Token::TYPE_QUALIFIER},
+        {"highp", Token::TYPE_QUALIFIER},
+
+        {"break", Token::TYPE_KEYWORD},
+        {"continue", Token::TYPE_KEYWORD},
+        {"do", Token::TYPE_KEYWORD},
+        {"for", Token::TYPE_KEYWORD},
+        {"while", Token::TYPE_KEYWORD},
+        {"switch", Token::TYPE_KEYWORD},
+        {"case", Token::TYPE_KEYWORD},
+        {"default", Token::TYPE_KEYWORD},
+        {"if", Token::TYPE_KEYWORD},
+        {"else", Token::TYPE_KEYWORD},
+        {"discard", Token::TYPE_KEYWORD},
+        {"return", Token::TYPE_KEYWORD},
+        {"true", Token::TYPE_KEYWORD},
+        {"false", Token::TYPE_KEYWORD},
+        {"precision", Token::TYPE_KEYWORD},
+        {"struct", Token::TYPE_KEYWORD},
+
+        {"void", Token::TYPE_BUILTIN_TYPE},
+        {"bool", Token::TYPE_BUILTIN_TYPE},
+        {"int", Token::TYPE_BUILTIN_TYPE},
+        {"uint", Token::TYPE_BUILTIN_TYPE},
+        {"float", Token::TYPE_BUILTIN_TYPE},
+        {"double", Token::TYPE_BUILTIN_TYPE},
+        {"vec2", Token::TYPE_BUILTIN_TYPE},
+        {"vec3", Token::TYPE_BUILTIN_TYPE},
+        {"vec4", Token::TYPE_BUILTIN_TYPE},
+        {"dvec2", Token::TYPE_BUILTIN_TYPE},
+        {"dvec3", Token::TYPE_BUILTIN_TYPE},
+        {"dvec4", Token::TYPE_BUILTIN_TYPE},
+        {"bvec2", Token::TYPE_BUILTIN_TYPE},
+        {"bvec3", Token::TYPE_BUILTIN_TYPE},
+        {"bvec4", Token::TYPE_BUILTIN_TYPE},
+        {"ivec2", Token::TYPE_BUILTIN_TYPE},
+        {"ivec3", Token::TYPE_BUILTIN_TYPE},
+        {"ivec4", Token::TYPE_BUILTIN_TYPE},
+        {"uvec2", Token::TYPE_BUILTIN_TYPE},
+        {"uvec3", Token::TYPE_BUILTIN_TYPE},
+        {"uvec4", Token::TYPE_BUILTIN_TYPE},
+        {"mat2", Token::TYPE_BUILTIN_TYPE},
+        {"mat3", Token::TYPE_BUILTIN_TYPE},
+        {"mat4", Token::TYPE_BUILTIN_TYPE},
+        {"mat2x2", Token::TYPE_BUILTIN_TYPE},
+        {"mat2x3", Token::TYPE_BUILTIN_TYPE},
+        {"mat2x4", Token::TYPE_BUILTIN_TYPE},
+        {"mat3x2", Token::TYPE_BUILTIN_TYPE},
+        {"mat3x3", Token::TYPE_BUILTIN_TYPE},
+        {"mat3x4", Token::TYPE_BUILTIN_TYPE},
+        {"mat4x2", Token::TYPE_BUILTIN_TYPE},
+        {"mat4x3", Token::TYPE_BUILTIN_TYPE},
+        {"mat4x4", Token::TYPE_BUILTIN_TYPE},
+        {"dmat2", Token::TYPE_BUILTIN_TYPE},
+        {"dmat3", Token::TYPE_BUILTIN_TYPE},
+        {"dmat4", Token::TYPE_BUILTIN_TYPE},
+        {"dmat2x2", Token::TYPE_BUILTIN_TYPE},
+        {"dmat2x3", Token::TYPE_BUILTIN_TYPE},
+        {"dmat2x4", Token::TYPE_BUILTIN_TYPE},
+        {"dmat3x2", Token::TYPE_BUILTIN_TYPE},
+        {"dmat3x3", Token::TYPE_BUILTIN_TYPE},
+        {"dmat3x4", Token::TYPE_BUILTIN_TYPE},
+        {"dmat4x2", Token::TYPE_BUILTIN_TYPE},
+        {"dmat4x3", Token::TYPE_BUILTIN_TYPE},
+        {"dmat4x4", Token::TYPE_BUILTIN_TYPE},
+        {"atomic_uint", Token::TYPE_BUILTIN_TYPE},
+
+        {"sampler1D", Token::TYPE_BUILTIN_TYPE},
+        {"sampler1DShadow", Token::TYPE_BUILTIN_TYPE},
+        {"sampler1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"sampler1DArrayShadow", Token::TYPE_BUILTIN_TYPE},
+        {"isampler1D", Token::TYPE_BUILTIN_TYPE},
+        {"isampler1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"usampler1D", Token::TYPE_BUILTIN_TYPE},
+        {"usampler1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2D", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DShadow", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DArrayShadow", Token::TYPE_BUILTIN_TYPE},
+        {"isampler2D", Token::TYPE_BUILTIN_TYPE},
+        {"isampler2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"usampler2D", Token::TYPE_BUILTIN_TYPE},
+        {"usampler2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DRectShadow", Token::TYPE_BUILTIN_TYPE},
+        {"isampler2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"usampler2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"isampler2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"usampler2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"sampler2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"isampler2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"usampler2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"sampler3D", Token::TYPE_BUILTIN_TYPE},
+        {"isampler3D", Token::TYPE_BUILTIN_TYPE},
+        {"usampler3D", Token::TYPE_BUILTIN_TYPE},
+        {"samplerCube", Token::TYPE_BUILTIN_TYPE},
+        {"samplerCubeShadow", Token::TYPE_BUILTIN_TYPE},
+        {"isamplerCube", Token::TYPE_BUILTIN_TYPE},
+        {"usamplerCube", Token::TYPE_BUILTIN_TYPE},
+        {"samplerCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"samplerCubeArrayShadow", Token::TYPE_BUILTIN_TYPE},
+        {"isamplerCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"usamplerCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"samplerBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"isamplerBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"usamplerBuffer", Token::TYPE_BUILTIN_TYPE},
+
+        {"image1D", Token::TYPE_BUILTIN_TYPE},
+        {"iimage1D", Token::TYPE_BUILTIN_TYPE},
+        {"uimage1D", Token::TYPE_BUILTIN_TYPE},
+        {"image1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"iimage1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"uimage1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"image2D", Token::TYPE_BUILTIN_TYPE},
+        {"iimage2D", Token::TYPE_BUILTIN_TYPE},
+        {"uimage2D", Token::TYPE_BUILTIN_TYPE},
+        {"image2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"iimage2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"uimage2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"image2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"iimage2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"uimage2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"image2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"iimage2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"uimage2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"image2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"iimage2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"uimage2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"image3D", Token::TYPE_BUILTIN_TYPE},
+        {"iimage3D", Token::TYPE_BUILTIN_TYPE},
+        {"uimage3D", Token::TYPE_BUILTIN_TYPE},
+        {"imageCube", Token::TYPE_BUILTIN_TYPE},
+        {"iimageCube", Token::TYPE_BUILTIN_TYPE},
+        {"uimageCube", Token::TYPE_BUILTIN_TYPE},
+        {"imageCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"iimageCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"uimageCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"imageBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"iimageBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"uimageBuffer", Token::TYPE_BUILTIN_TYPE},
+
+        {"sampler", Token::TYPE_BUILTIN_TYPE},
+        {"samplerShadow", Token::TYPE_BUILTIN_TYPE},
+        {"texture1D", Token::TYPE_BUILTIN_TYPE},
+        {"itexture1D", Token::TYPE_BUILTIN_TYPE},
+        {"utexture1D", Token::TYPE_BUILTIN_TYPE},
+        {"texture1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"itexture1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"utexture1DArray", Token::TYPE_BUILTIN_TYPE},
+        {"texture2D", Token::TYPE_BUILTIN_TYPE},
+        {"itexture2D", Token::TYPE_BUILTIN_TYPE},
+        {"utexture2D", Token::TYPE_BUILTIN_TYPE},
+        {"texture2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"itexture2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"utexture2DArray", Token::TYPE_BUILTIN_TYPE},
+        {"texture2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"itexture2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"utexture2DRect", Token::TYPE_BUILTIN_TYPE},
+        {"texture2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"itexture2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"utexture2DMS", Token::TYPE_BUILTIN_TYPE},
+        {"texture2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"itexture2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"utexture2DMSArray", Token::TYPE_BUILTIN_TYPE},
+        {"texture3D", Token::TYPE_BUILTIN_TYPE},
+        {"itexture3D", Token::TYPE_BUILTIN_TYPE},
+        {"utexture3D", Token::TYPE_BUILTIN_TYPE},
+        {"textureCube", Token::TYPE_BUILTIN_TYPE},
+        {"itextureCube", Token::TYPE_BUILTIN_TYPE},
+        {"utextureCube", Token::TYPE_BUILTIN_TYPE},
+        {"textureCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"itextureCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"utextureCubeArray", Token::TYPE_BUILTIN_TYPE},
+        {"textureBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"itextureBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"utextureBuffer", Token::TYPE_BUILTIN_TYPE},
+        {"subpassInput", Token::TYPE_BUILTIN_TYPE},
+        {"isubpassInput", Token::TYPE_BUILTIN_TYPE},
+        {"usubpassInput", Token::TYPE_BUILTIN_TYPE},
+        {"subpassInputMS", Token::TYPE_BUILTIN_TYPE},
+        {"isubpassInputMS", Token::TYPE_BUILTIN_TYPE},
+        {"usubpassInputMS", Token::TYPE_BUILTIN_TYPE},
+    };
+
+    constexpr uint32 NUM_KEYWORDS = (uint32)countof(KEYWORDS);
+
+    // Two level perfect hash (hash and displace): a word's first hash picks a bucket, the
+    // bucket's displacement is mixed into the hash again to pick a slot. Displacements are
+    // searched at compile time so that every keyword lands in its own slot, which makes a
+    // lookup two table reads and at most one string compare no matter how many keywords exist.
+    constexpr uint32 KEYWORD_TABLE_SIZE = 512;
+    constexpr uint32 KEYWORD_BUCKET_COUNT = 128;
+    constexpr uint32 MAX_DISPLACEMENT = 0xFFFF;
+
+    static_assert(NUM_KEYWORDS < KEYWORD_TABLE_SIZE, "Keyword table is too small");
+
+    constexpr uint32 hashWord(const char* str, size_t length) {
+        uint32 hash = 2166136261u;
+
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ (uint8)str[i]) * 16777619u;
+        }
+
+        return hash;
+    }
+
+    constexpr uint32 getKeywordSlot(uint32 hash, uint32 displacement) {
+        uint32 h = hash + displacement * 0x9E3779B9u;
+
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+
+        return h & (KEYWORD_TABLE_SIZE - 1);
+    }
+
+    constexpr size_t getLength(const char* str) {
+        size_t length = 0;
+
+        while (str[length] != '\0') {
+            ++length;
+        }
+
+        return length;
+    }
+
+    struct KeywordTable {
+        uint16 displacements[KEYWORD_BUCKET_COUNT];
+        int16 slots[KEYWORD_TABLE_SIZE]; // index into KEYWORDS, -1 if empty
+        bool valid;
+    };
+
+    constexpr KeywordTable buildKeywordTable() {
+        KeywordTable table = {};
+        uint32 hashes[NUM_KEYWORDS] = {};
+        uint32 bucketSizes[KEYWORD_BUCKET_COUNT] = {};
+        uint32 bucketOrder[KEYWORD_BUCKET_COUNT] = {};
+
+        for (uint32 i = 0; i < KEYWORD_TABLE_SIZE; ++i) {
+            table.slots[i] = -1;
+        }
+
+        for (uint32 i = 0; i < NUM_KEYWORDS; ++i) {
+            hashes[i] = hashWord(KEYWORDS[i].name, getLength(KEYWORDS[i].name));
+            ++bucketSizes[hashes[i] % KEYWORD_BUCKET_COUNT];
+        }
+
+        for (uint32 i = 0; i < KEYWORD_BUCKET_COUNT; ++i) {
+            bucketOrder[i] = i;
+        }
+
+        // place the most crowded buckets first while the table is still mostly empty
+        for (uint32 i = 0; i < KEYWORD_BUCKET_COUNT; ++i) {
+            for (uint32 j = i + 1; j < KEYWORD_BUCKET_COUNT; ++j) {
+                if (bucketSizes[bucketOrder[j]] > bucketSizes[bucketOrder[i]]) {
+                    uint32 tmp = bucketOrder[i];
+                    bucketOrder[i] = bucketOrder[j];
+                    bucketOrder[j] = tmp;
+                }
+            }
+        }
+
+        for (uint32 b = 0; b < KEYWORD_BUCKET_COUNT; ++b) {
+            uint32 bucket = bucketOrder[b];
+
+            if (bucketSizes[bucket] == 0) {
+                break;
+            }
+
+            bool placed = false;
+
+            for (uint32 d = 0; d <= MAX_DISPLACEMENT && !placed; ++d) {
+                placed = true;
+
+                for (uint32 i = 0; i < NUM_KEYWORDS && placed; ++i) {
+                    if (hashes[i] % KEYWORD_BUCKET_COUNT != bucket) {
+                        continue;
+                    }
+
+                    uint32 slot = getKeywordSlot(hashes[i], d);
+
+                    if (table.slots[slot] != -1) {
+                        placed = false;
+                    }
+
+                    // claim the slot so later keywords of this bucket can't reuse it
+                    for (uint32 j = 0; j < i && placed; ++j) {
+                        if (hashes[j] % KEYWORD_BUCKET_COUNT == bucket
+                                && getKeywordSlot(hashes[j], d) == slot) {
+                            placed = false;
+                        }
+                    }
+                }
+
+                if (placed) {
+                    table.displacements[bucket] = (uint16)d;
+
+                    for (uint32 i = 0; i < NUM_KEYWORDS; ++i) {
+                        if (hashes[i] % KEYWORD_BUCKET_COUNT == bucket) {
+                            table.slots[getKeywordSlot(hashes[i], d)] = (int16)i;
+                        }
+                    }
+                }
+            }
+
+            if (!placed) {
+                return table;
+            }
+        }
+
+        table.valid = true;
+
+        return table;
+    }
+
+    constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+
+    static_assert(KEYWORD_TABLE.valid, "Failed to build a perfect hash for the keyword table");
+};
+
+Token::TokenType ShaderLexer::classifyWord(StringView word) {
+    uint32 hash = ::hashWord(word.data(), word.size());
+    uint32 displacement = ::KEYWORD_TABLE.displacements[hash % ::KEYWORD_BUCKET_COUNT];
+    int16 index = ::KEYWORD_TABLE.slots[::getKeywordSlot(hash, displacement)];
+
+    if (index != -1 && word.compare(::KEYWORDS[index].name) == 0) {
+        return ::KEYWORDS[index].type;
+    }
+
+    return Token::TYPE_IDENTIFIER;
+}
+
+void ShaderLexer::Lexer::reset(StringView source, const char* fileName, uint32 line) {
+    c = source.data();
+    end = c + source.size();
+
+    this->fileName = fileName;
+    this->line = line;
+}
+
+bool ShaderLexer::Lexer::next(Token& token) {
+    const Scanner& scan = ShaderLexer::getScanner();
+
+    while (c != end) {
+        if (std::isalpha((unsigned char)*c) || *c == '_') {
+            const char* start = c;
+            c = scan.skipIdentifier(c + 1, end);
+
+            StringView str(start, c - start);
+            token = {ShaderLexer::classifyWord(str), line, str, fileName};
+
+            return true;
+        }
+        else if (std::isdigit((unsigned char)*c)) {
+            const char* start = c;
+            c = scan.skipNumber(c + 1, end);
+
+            token = {Token::TYPE_NUMERIC, line, StringView(start, c - start), fileName};
+
+            return true;
+        }
+        else if (std::isspace((unsigned char)*c)) {
+            c = scan.skipWhitespace(c, end, line);
+        }
+        else if (*c == '/' && c + 1 != end && c[1] == '/') {
+            // the newline itself is left for the whitespace scanner to count
+            const char* lineEnd = static_cast<const char*>(std::memchr(c + 2, '\n', end - c - 2));
+            c = lineEnd != nullptr ? lineEnd : end;
+        }
+        else if (*c == '/' && c + 1 != end && c[1] == '*') {
+            c = scan.skipBlockComment(c + 2, end, line);
+        }
+        else {
+            Token::TokenType type;
+
+            switch (*c) {
+                case '(':
+                    type = Token::TYPE_OPEN_PAREN;
+                    break;
+                case ')':
+                    type = Token::TYPE_CLOSE_PAREN;
+                    break;
+                case '#':
+                    type = Token::TYPE_POUND_SIGN;
+                    break;
+                case '=':
+                    type = Token::TYPE_EQUAL_SIGN;
+                    break;
+                case ',':
+                    type = Token::TYPE_COMMA;
+                    break;
+                case ';':
+                    type = Token::TYPE_SEMI_COLON;
+                    break;
+                case '{':
+                    type = Token::TYPE_OPEN_CURLY;
+                    break;
+                case '}':
+                    type = Token::TYPE_CLOSE_CURLY;
+                    break;
+                case '[':
+                    type = Token::TYPE_OPEN_SQUARE;
+                    break;
+                case ']':
+                    type = Token::TYPE_CLOSE_SQUARE;
+                    break;
+                default:
+                    type = Token::TYPE_OPERATOR;
+            }
+
+            token = {type, line, StringView(c, 1), fileName};
+            ++c;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ShaderLexer::tokenizeShaderSource(StringView source, const char* fileName, uint32 line,
+        ArrayList<Token>& tokens) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_LEX);
+    Trace::Scope scope("Lex", fileName);
+
+    Lexer lexer;
+    lexer.reset(source, fileName, line);
+
+    Token token;
+
+    while (lexer.next(token)) {
+        tokens.push_back(token);
+    }
+}
+
+void ShaderLexer::DeclarationScanner::setSource(StringView source, uint32 line) {
+    sourceStart = source.data();
+    c = sourceStart;
+    end = c + source.size();
+    this->line = line;
+
+    // a declaration cut off by the end of the previous span continues at the start of this one
+    regionStart = c;
+    regionLine = line;
+}
+
+bool ShaderLexer::DeclarationScanner::nextRegion(StringView& region, uint32& startLine) {
+    const Scanner& scan = ShaderLexer::getScanner();
+
+    while (c != end) {
+        if (state == State::STATEMENT_START) {
+            c = scan.skipWhitespace(c, end, line);
+
+            if (c == end) {
+                break;
+            }
+
+            if (*c == '/' && c + 1 != end && (c[1] == '/' || c[1] == '*')) {
+                if (c[1] == '/') {
+                    const char* lineEnd = static_cast<const char*>(std::memchr(c, '\n', end - c));
+                    c = lineEnd != nullptr ? lineEnd : end;
+                }
+                else {
+                    c = scan.skipBlockComment(c + 2, end, line);
+                }
+
+                continue;
+            }
+
+            if (*c == '#') {
+                const char* lineEnd = static_cast<const char*>(std::memchr(c, '\n', end - c));
+                lineEnd = lineEnd != nullptr ? lineEnd : end;
+
+                startLine = line;
+
+                // a backslash at the end of the line continues the directive on the next one
+                while (lineEnd != end && (lineEnd[-1] == '\\'
+                        || (lineEnd[-1] == '\r' && lineEnd[-2] == '\\'))) {
+                    const char* next = static_cast<const char*>(std::memchr(lineEnd + 1, '\n',
+                            end - lineEnd - 1));
+
+                    lineEnd = next != nullptr ? next : end;
+                    ++line;
+                }
+
+                region = StringView(c, lineEnd - c);
+                c = lineEnd;
+
+                return true;
+            }
+
+            depth = 0;
+            functionBody = false;
+            state = State::SKIPPED_STATEMENT;
+
+            if (std::isalpha((unsigned char)*c) || *c == '_') {
+                const char* wordEnd = scan.skipIdentifier(c + 1, end);
+                StringView word(c, wordEnd - c);
+
+                switch (ShaderLexer::classifyWord(word)) {
+                    case Token::TYPE_LAYOUT:
+                    case Token::TYPE_IN:
+                    case Token::TYPE_OUT:
+                    case Token::TYPE_UNIFORM:
+                    case Token::TYPE_BUFFER:
+                    case Token::TYPE_MEMORY_QUALIFIER:
+                        state = State::DECLARATION;
+                        break;
+                    case Token::TYPE_QUALIFIER:
+                        // precision and invariance qualifiers also lead ordinary declarations
+                        state = word == "const" || word == "lowp" || word == "mediump"
+                                || word == "highp" || word == "precise" || word == "invariant"
+                                ? State::SKIPPED_STATEMENT : State::DECLARATION;
+                        break;
+                    case Token::TYPE_KEYWORD:
+                        if (word == "struct") {
+                            state = State::DECLARATION;
+                        }
+
+                        break;
+                    default:
+                        break;
+                }
+
+                if (state == State::DECLARATION) {
+                    regionStart = c;
+                    regionLine = line;
+                }
+
+                c = wordEnd;
+            }
+
+            continue;
+        }
+
+        c = scan.skipToStructural(c, end, line);
+
+        if (c == end) {
+            break;
+        }
+
+        switch (*c) {
+            case '/':
+                if (c + 1 != end && c[1] == '/') {
+                    const char* lineEnd = static_cast<const char*>(std::memchr(c, '\n', end - c));
+                    c = lineEnd != nullptr ? lineEnd : end;
+                }
+                else if (c + 1 != end && c[1] == '*') {
+                    c = scan.skipBlockComment(c + 2, end, line);
+                }
+                else {
+                    ++c;
+                }
+
+                break;
+            case '{':
+                if (depth == 0) {
+                    const char* prev = c;
+
+                    while (prev != sourceStart && std::isspace((unsigned char)prev[-1])) {
+                        --prev;
+                    }
+
+                    if (prev != sourceStart && prev[-1] == ')') {
+                        functionBody = true;
+                        state = State::SKIPPED_STATEMENT;
+                    }
+                }
+
+                ++depth;
+                ++c;
+
+                break;
+            case '}':
+                ++c;
+
+                if (depth > 0 && --depth == 0 && functionBody) {
+                    state = State::STATEMENT_START;
+                }
+
+                break;
+            case ';':
+                ++c;
+
+                if (depth == 0) {
+                    bool declaration = state == State::DECLARATION;
+                    state = State::STATEMENT_START;
+
+                    if (declaration) {
+                        region = StringView(regionStart, c - regionStart);
+                        startLine = regionLine;
+
+                        return true;
+                    }
+                }
+
+                break;
+            default:
+                // directives inside a statement stay part of it
+                ++c;
+        }
+    }
+
+    // emitted once, the rest of the declaration arrives with the next span
+    if (state == State::DECLARATION && regionStart != end) {
+        region = StringView(regionStart, end - regionStart);
+        startLine = regionLine;
+        regionStart = end;
+
+        return true;
+    }
+
+    return false;
+}
+
+const char* ShaderLexer::stringifyTokenType(enum Token::TokenType type) {
+    switch (type) {
+        case Token::TYPE_IDENTIFIER:
+            return "identifier";
+        case Token::TYPE_NUMERIC:
+            return "numeric literal";
+        case Token::TYPE_OPERATOR:
+            return "operator";
+        case Token::TYPE_LAYOUT:
+            return "layout";
+        case Token::TYPE_IN:
+            return "in";
+        case Token::TYPE_OUT:
+            return "out";
+        case Token::TYPE_UNIFORM:
+            return "uniform";
+        case Token::TYPE_BUFFER:
+            return "buffer";
+        case Token::TYPE_MEMORY_QUALIFIER:
+            return "memory qualifier";
+        case Token::TYPE_QUALIFIER:
+            return "qualifier";
+        case Token::TYPE_BUILTIN_TYPE:
+            return "builtin type";
+        case Token::TYPE_KEYWORD:
+            return "keyword";
+        case Token::TYPE_OPEN_PAREN:
+            return "(";
+        case Token::TYPE_CLOSE_PAREN:
+            return ")";
+        case Token::TYPE_POUND_SIGN:
+            return "#";
+        case Token::TYPE_EQUAL_SIGN:
+            return "=";
+        case Token::TYPE_COMMA:
+            return ",";
+        case Token::TYPE_SEMI_COLON:
+            return ";";
+        case Token::TYPE_OPEN_CURLY:
+            return "{";
+        case Token::TYPE_CLOSE_CURLY:
+            return "}";
+        case Token::TYPE_OPEN_SQUARE:
+            return "[";
+        case Token::TYPE_CLOSE_SQUARE:
+            return "]";
+        default:
+            return "invalid token";
+    }
+}
+
+void ShaderLexer::logDiagnostic(const Diagnostic& diagnostic) {
+    const char* level = diagnostic.severity == Diagnostic::Severity::WARNING ? LOG_WARNING
+            : LOG_ERROR;
+
+    if (diagnostic.column != 0) {
+        DEBUG_LOG("Shader Parser", level, "%s (%s:%u:%u)", diagnostic.message.c_str(),
+                diagnostic.fileName.c_str(), diagnostic.line, diagnostic.column);
+    }
+    else if (diagnostic.line != 0) {
+        DEBUG_LOG("Shader Parser", level, "%s (%s:%u)", diagnostic.message.c_str(),
+                diagnostic.fileName.c_str(), diagnostic.line);
+    }
+    else {
+        DEBUG_LOG("Shader Parser", level, "%s (%s)", diagnostic.message.c_str(),
+                diagnostic.fileName.c_str());
+    }
+}
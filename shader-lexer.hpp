@@ -0,0 +1,123 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+
+namespace ShaderLexer {
+    struct Token {
+        enum TokenType {
+            TYPE_IDENTIFIER,
+            TYPE_NUMERIC,
+            TYPE_OPERATOR,
+
+            TYPE_LAYOUT,
+            TYPE_IN,
+            TYPE_OUT,
+            TYPE_UNIFORM,
+            TYPE_BUFFER,
+            TYPE_MEMORY_QUALIFIER,
+            TYPE_QUALIFIER,
+            TYPE_BUILTIN_TYPE,
+            TYPE_KEYWORD,
+
+            TYPE_OPEN_PAREN,
+            TYPE_CLOSE_PAREN,
+            TYPE_POUND_SIGN,
+            TYPE_EQUAL_SIGN,
+            TYPE_COMMA,
+            TYPE_SEMI_COLON,
+            TYPE_OPEN_CURLY,
+            TYPE_CLOSE_CURLY,
+            TYPE_OPEN_SQUARE,
+            TYPE_CLOSE_SQUARE,
+
+            TYPE_INVALID
+        };
+
+        TokenType type = TYPE_INVALID;
+        uint32 line;
+        StringView data; // slice of the source buffer passed to tokenizeShaderSource
+        const char* fileName;
+    };
+
+    // An error found in a source, at the place it was found
+    struct Diagnostic {
+        enum class Severity {
+            ERROR,
+            // the declaration still parsed, with something left out of its reflection
+            WARNING
+        };
+
+        String fileName;
+        // 0 at the end of a source that has no tokens
+        uint32 line;
+        // 1 based, 0 if unknown, such as for tokens expanded from a macro
+        uint32 column;
+        String message;
+        Severity severity = Severity::ERROR;
+    };
+
+    // Produces the tokens of a source one at a time, so a consumer never has to hold more
+    // than the token it is looking at
+    class Lexer {
+        public:
+            // line is the line number source starts on
+            void reset(StringView source, const char* fileName, uint32 line);
+
+            // false once the source is exhausted
+            bool next(Token& token);
+        private:
+            const char* c = nullptr;
+            const char* end = nullptr;
+            const char* fileName = nullptr;
+            uint32 line = 0;
+    };
+
+    // appends the tokens of source to tokens, line is the line number source starts on
+    void tokenizeShaderSource(StringView source, const char* fileName, uint32 line,
+            ArrayList<Token>& tokens);
+
+    // Finds the parts of a source that can declare interface variables: top level statements
+    // that start with layout, an interface storage, memory or interpolation qualifier, or
+    // struct, plus preprocessor lines between statements. Everything else, function bodies in
+    // particular, is skipped by brace matching without being tokenized. Spans of a linked
+    // source are fed in order, state carries over from one to the next.
+    class DeclarationScanner {
+        public:
+            // line is the line number source starts on
+            void setSource(StringView source, uint32 line);
+
+            // next region of the current source worth tokenizing, false once it is exhausted
+            bool nextRegion(StringView& region, uint32& startLine);
+        private:
+            enum class State {
+                STATEMENT_START,
+                DECLARATION,
+                SKIPPED_STATEMENT
+            };
+
+            State state = State::STATEMENT_START;
+            uint32 depth = 0;
+            // the skipped statement is a function definition, so its closing brace ends it
+            bool functionBody = false;
+
+            const char* sourceStart = nullptr;
+            const char* c = nullptr;
+            const char* end = nullptr;
+            uint32 line = 0;
+
+            const char* regionStart = nullptr;
+            uint32 regionLine = 0;
+    };
+
+    // keyword category of an identifier-like word, TYPE_IDENTIFIER if it is no keyword
+    Token::TokenType classifyWord(StringView word);
+
+    const char* stringifyTokenType(enum Token::TokenType type);
+
+    // writes diagnostic to stderr
+    void logDiagnostic(const Diagnostic& diagnostic);
+};
@@ -0,0 +1,123 @@
+#include "shader-memory-layout.hpp"
+
+#include <algorithm>
+
+namespace {
+    // the base alignment of a vec4, which std140 rounds arrays and structures up to
+    constexpr uint32 VEC4_ALIGNMENT = 16;
+
+    bool parseBuiltinType(StringView name, uint32& componentSize, uint32& columns,
+            uint32& rows);
+    uint32 getVectorAlignment(uint32 componentSize, uint32 components,
+            ShaderInfo::MemoryLayout memoryLayout);
+};
+
+bool ShaderMemoryLayout::getBuiltinTypeLayout(StringView typeName,
+        ShaderInfo::MemoryLayout memoryLayout, bool rowMajor, TypeLayout& layout) {
+    uint32 componentSize, columns, rows;
+
+    if (!::parseBuiltinType(typeName, componentSize, columns, rows)) {
+        return false;
+    }
+
+    if (columns == 1) {
+        layout.size = rows * componentSize;
+        layout.alignment = ::getVectorAlignment(componentSize, rows, memoryLayout);
+        layout.matrixStride = 0;
+
+        return true;
+    }
+
+    // a matrix is laid out like an array of its columns, or of its rows if it is row major
+    uint32 vectors = rowMajor ? rows : columns;
+    uint32 components = rowMajor ? columns : rows;
+
+    TypeLayout vector = {components * componentSize,
+            ::getVectorAlignment(componentSize, components, memoryLayout), 0};
+    uint32 stride;
+
+    ShaderMemoryLayout::getArrayLayout(vector, memoryLayout, layout.alignment, stride);
+
+    layout.size = vectors * stride;
+    layout.matrixStride = stride;
+
+    return true;
+}
+
+void ShaderMemoryLayout::getArrayLayout(const TypeLayout& element,
+        ShaderInfo::MemoryLayout memoryLayout, uint32& alignment, uint32& stride) {
+    alignment = memoryLayout == ShaderInfo::MemoryLayout::STD140
+            ? (uint32)ShaderMemoryLayout::alignOffset(element.alignment, ::VEC4_ALIGNMENT)
+            : element.alignment;
+    stride = (uint32)ShaderMemoryLayout::alignOffset(element.size, alignment);
+}
+
+uint32 ShaderMemoryLayout::getStructureAlignment(uint32 memberAlignment,
+        ShaderInfo::MemoryLayout memoryLayout) {
+    return memoryLayout == ShaderInfo::MemoryLayout::STD140
+            ? (uint32)ShaderMemoryLayout::alignOffset(memberAlignment, ::VEC4_ALIGNMENT)
+            : memberAlignment;
+}
+
+namespace {
+    bool parseBuiltinType(StringView name, uint32& componentSize, uint32& columns,
+            uint32& rows) {
+        componentSize = 4;
+        columns = 1;
+        rows = 1;
+
+        if (name == "float" || name == "int" || name == "uint" || name == "bool") {
+            return true;
+        }
+
+        if (name == "double") {
+            componentSize = 8;
+            return true;
+        }
+
+        // dvec, ivec, uvec, bvec and dmat
+        if (name.size() > 4 && (name.compare(1, 3, "vec") == 0 || name.compare(1, 3, "mat") == 0)) {
+            if (name[0] == 'd') {
+                componentSize = 8;
+            }
+            else if (name[1] == 'm' || (name[0] != 'i' && name[0] != 'u' && name[0] != 'b')) {
+                return false;
+            }
+
+            name.remove_prefix(1);
+        }
+
+        if (name.size() == 4 && name.compare(0, 3, "vec") == 0 && name[3] >= '2' && name[3] <= '4') {
+            rows = name[3] - '0';
+            return true;
+        }
+
+        if (name.compare(0, 3, "mat") != 0 || name.size() < 4 || name[3] < '2' || name[3] > '4') {
+            return false;
+        }
+
+        columns = name[3] - '0';
+        rows = columns;
+
+        if (name.size() == 4) {
+            return true;
+        }
+
+        if (name.size() == 6 && name[4] == 'x' && name[5] >= '2' && name[5] <= '4') {
+            rows = name[5] - '0';
+            return true;
+        }
+
+        return false;
+    }
+
+    uint32 getVectorAlignment(uint32 componentSize, uint32 components,
+            ShaderInfo::MemoryLayout memoryLayout) {
+        if (memoryLayout == ShaderInfo::MemoryLayout::SCALAR || components == 1) {
+            return componentSize;
+        }
+
+        // three component vectors are aligned like four component ones
+        return componentSize * (components == 2 ? 2 : 4);
+    }
+};
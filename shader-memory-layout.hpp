@@ -0,0 +1,32 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string-view.hpp>
+
+#include "shader-parser.hpp"
+
+// Offset rules of the std140 and std430 layouts (GLSL 4.60 section 7.6.2.2) and of the
+// scalar layout of GL_EXT_scalar_block_layout
+namespace ShaderMemoryLayout {
+    struct TypeLayout {
+        uint32 size;
+        uint32 alignment;
+        uint32 matrixStride; // 0 unless the type is a matrix
+    };
+
+    // 64 bit so offsets past the 32 bit range can be detected rather than wrapping
+    inline uint64 alignOffset(uint64 offset, uint32 alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // layout of a scalar, vector or matrix type, false for any other type name
+    bool getBuiltinTypeLayout(StringView typeName, ShaderInfo::MemoryLayout memoryLayout,
+            bool rowMajor, TypeLayout& layout);
+
+    // alignment of an array of element and the distance between its elements
+    void getArrayLayout(const TypeLayout& element, ShaderInfo::MemoryLayout memoryLayout,
+            uint32& alignment, uint32& stride);
+
+    // alignment of a structure whose largest member alignment is memberAlignment
+    uint32 getStructureAlignment(uint32 memberAlignment, ShaderInfo::MemoryLayout memoryLayout);
+};
@@ -1,74 +1,261 @@
 #include "shader-parser.hpp"
 
-#include <cctype>
+#include "shader-cache.hpp"
+#include "shader-lexer.hpp"
+#include "shader-memory-layout.hpp"
+#include "shader-preprocessor.hpp"
+#include "shader-source.hpp"
+#include "shader-stats.hpp"
+#include "shader-token-stream.hpp"
+
+#include <engine/core/hash-map.hpp>
+#include <engine/core/thread-pool.hpp>
+#include <engine/core/trace.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <initializer_list>
 
 namespace {
-    struct Token {
-        enum TokenType {
-            TYPE_IDENTIFIER,
-            TYPE_NUMERIC,
-            TYPE_OPERATOR,
-
-            TYPE_LAYOUT,
-            TYPE_IN,
-            TYPE_OUT,
-            TYPE_UNIFORM,
-            TYPE_BUFFER,
-            TYPE_MEMORY_QUALIFIER,
-
-            TYPE_OPEN_PAREN,
-            TYPE_CLOSE_PAREN,
-            TYPE_POUND_SIGN,
-            TYPE_EQUAL_SIGN,
-            TYPE_COMMA,
-            TYPE_SEMI_COLON,
-            TYPE_OPEN_CURLY,
-            TYPE_CLOSE_CURLY,
-            TYPE_OPEN_SQUARE,
-            TYPE_CLOSE_SQUARE,
-
-            TYPE_INVALID
+    using Token = ShaderLexer::Token;
+
+    using Symbol = ShaderInfo::Symbol;
+
+    // Struct definitions visible to a parse and the layouts computed for them. A struct is
+    // laid out once per memory layout it is used under, every further use copies the result.
+    struct TypeTable {
+        struct StructLayout {
+            uint32 size;
+            uint32 alignment;
+            // leaf members named and placed relative to the struct
+            ArrayList<ShaderInfo::Variable> members;
+            // why the struct can't be laid out, empty if it can
+            String unplaced;
         };
 
-        TokenType type = TYPE_INVALID;
-        String data;
-        uint32 line;
+        // a struct array is unrolled into its elements while that adds at most this many
+        // members, past that its first element stands in for all of them
+        static constexpr uint32 MAX_UNROLLED_MEMBERS = 256;
+
+        ShaderInfo& shaderInfo;
+        ArrayList<ShaderInfo::StructType>& structTypes;
+        HashMap<Symbol, uint32> structIndices;
+        // keyed by struct index, memory layout and matrix order
+        HashMap<uint64, Memory::UniquePointer<StructLayout>> structLayouts;
+        // scratch for the paths of flattened members
+        String path;
+        // why the last placeMembers() that failed did
+        String unplaced;
+
+        TypeTable(ShaderInfo& shaderInfo, ArrayList<ShaderInfo::StructType>& structTypes);
+
+        void addStruct(const ShaderInfo::StructType& structType);
+        const StructLayout* getStructLayout(uint32 index, ShaderInfo::MemoryLayout memoryLayout,
+                bool rowMajor);
+
+        // Places count members one after another starting at 0 and appends their leaf members
+        // to flattened. end is where the last member ends and alignment the largest member
+        // alignment. false if a member type has no known layout or the members don't fit in
+        // 32 bit offsets, then unplacedMember is the member it was found in and unplaced says
+        // why, naming owner as the block or struct.
+        bool placeMembers(ShaderInfo::Variable* members, uint32 count, Symbol owner,
+                ShaderInfo::MemoryLayout memoryLayout, bool rowMajor, uint32& end,
+                uint32& alignment, ArrayList<ShaderInfo::Variable>& flattened,
+                uint32& unplacedMember);
     };
 
-    void tokenizeShaderSource(std::istream& fileStream, ArrayList<Token>& tokens);
+    // Scratch space a layout is assembled in before being copied into the arena. One builder
+    // is reused for every layout of a parse, so its lists stop allocating after the first few.
+    struct LayoutBuilder {
+        StringInterner& interner;
+        Symbol std140Symbol;
+        Symbol std430Symbol;
+        Symbol scalarSymbol;
+        Symbol rowMajorSymbol;
+        Symbol pushConstantSymbol;
+
+        ShaderInfo::LayoutType type;
+        ShaderInfo::MemoryLayout memoryLayout;
+
+        ArrayList<ShaderInfo::Option> options;
+        ArrayList<Symbol> memoryQualifiers;
+        Symbol name;
+        Symbol typeQualifier;
+
+        ShaderInfo::DescriptorType descriptorType;
+        Symbol imageFormat;
+        bool isArray;
+        int32 arraySize;
+        Symbol defaultValue;
+
+        ArrayList<ShaderInfo::Variable> body;
+        ArrayList<ShaderInfo::Variable> flattenedBody;
+        uint32 blockSize;
+        uint32 unsizedArrayStride;
+        // the name of each member of body, for the warnings of computeMemoryLayout()
+        ArrayList<Token> memberTokens;
+
+        explicit LayoutBuilder(StringInterner& interner);
+
+        void clear();
+
+        inline Symbol intern(const Token& token) { return interner.intern(token.data); }
+
+        bool hasOption(Symbol optionName) const;
+        void setOption(Symbol optionName, int32 value);
+        // any of the local_size_x, local_size_y, local_size_z options or their _id forms
+        bool hasWorkgroupSize() const;
+
+        // places the members of a buffer block, false and warned about if a member type has
+        // no known layout
+        bool computeMemoryLayout(TypeTable& types, ShaderLexer::TokenStream& tokens);
+
+        ShaderInfo::Layout build(Memory::Arena& arena) const;
+    };
+
+    // a declaration that fails to parse is reported and skipped, the rest of the source is
+    // still parsed
+    bool parseTokens(ShaderLexer::TokenStream& tokens, ShaderInfo& shaderInfo,
+            Memory::Arena& arena, ArrayList<ShaderInfo::Layout>& layoutInfo,
+            ArrayList<ShaderInfo::StructType>& structTypes,
+            ArrayList<ShaderLexer::Diagnostic>& diagnostics);
 
-    bool consumeLayout(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            ArrayList<ShaderInfo::Layout>& layoutInfo);
+    bool consumeLayout(ShaderLexer::TokenStream& tokens, LayoutBuilder& li, TypeTable& types);
         
-    bool consumeLayoutOptions(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            ShaderInfo::Layout& li);
-    bool consumeLayoutQualifiers(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            ShaderInfo::Layout& li);
-    bool consumeLayoutVariables(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            ShaderInfo::Layout& li);
-
-    bool expect(const ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            Token::TokenType type);
-    bool expect(const ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
+    bool consumeLayoutOptions(ShaderLexer::TokenStream& tokens, LayoutBuilder& li);
+    bool consumeLayoutQualifiers(ShaderLexer::TokenStream& tokens, LayoutBuilder& li);
+    bool consumeLayoutVariables(ShaderLexer::TokenStream& tokens, LayoutBuilder& li);
+    // type name = literal;, the layout and const already consumed
+    bool consumeSpecializationConstant(ShaderLexer::TokenStream& tokens, LayoutBuilder& li);
+    // [size] after the name of a variable, member or block instance, if there is one. The
+    // size is -1 if it is left out and 0 if it is not an integer literal.
+    bool consumeArraySize(ShaderLexer::TokenStream& tokens, bool& isArray, int32& arraySize);
+
+    // shared type name[, name];, the shared qualifier already consumed. Adds a layout per name.
+    bool consumeShared(ShaderLexer::TokenStream& tokens, LayoutBuilder& li,
+            Memory::Arena& arena, ArrayList<ShaderInfo::Layout>& layoutInfo);
+
+    // struct Name { members } [declarators];, the struct keyword already consumed
+    bool consumeStruct(ShaderLexer::TokenStream& tokens, LayoutBuilder& li, TypeTable& types,
+            Memory::Arena& arena);
+    // { members } of a block or struct
+    bool consumeMembers(ShaderLexer::TokenStream& tokens, LayoutBuilder& li,
+            ArrayList<ShaderInfo::Variable>& members);
+
+    // pulls the next token into token if it has the type, otherwise reports it and leaves
+    // it in the stream
+    bool expect(ShaderLexer::TokenStream& tokens, const Token*& token, Token::TokenType type);
+    bool expect(ShaderLexer::TokenStream& tokens, const Token*& token,
             std::initializer_list<Token::TokenType> types);
 
-    const char* stringifyTokenType(enum Token::TokenType type);
+    // panic mode recovery after an error: skips to the end of the declaration, the next ; or }
+    // outside of braces opened while skipping, or up to the next layout or struct
+    void synchronize(ShaderLexer::TokenStream& tokens);
+
+    bool parseInteger(ShaderLexer::TokenStream& tokens, const Token& token, int32& value);
+
+    // the descriptor type of a uniform of an opaque type, NONE for any other type
+    ShaderInfo::DescriptorType getDescriptorType(StringView typeName);
+    bool isImageFormat(StringView option);
 };
 
+ShaderInfo::ShaderInfo(Memory::SharedPointer<StringInterner> interner, uintptr arenaBlockSize)
+        : interner(std::move(interner))
+        , arena(arenaBlockSize) {}
+
 bool ShaderInfo::parse(std::istream& shaderData) {
-    ArrayList<Token> tokens;
-    ::tokenizeShaderSource(shaderData, tokens);
+    ShaderStats::Collect collect(stats);
+    String source;
 
-    for (auto it = tokens.begin(), end = tokens.end(); it != end; ++it) {
-		if (it->type == Token::TYPE_LAYOUT) {
-			if (!::consumeLayout(it, end, layoutInfo)) {
-				return false;
-			}
-		}
-	}
+    {
+        ShaderStats::Timer timer(ShaderStats::PHASE_LOAD);
 
-	return true;
+        StringStream ss;
+        ss << shaderData.rdbuf();
+        source = String(ss.str());
+    }
+
+    return parse(StringView(source));
+}
+
+bool ShaderInfo::parse(StringView shaderData, ScanMode mode) {
+    ShaderStats::Collect collect(stats);
+    ShaderLexer::TokenStream tokens(shaderData, "<source>", mode == ScanMode::DECLARATIONS);
+
+    return ::parseTokens(tokens, *this, arena, layoutInfo, structTypes, diagnostics);
+}
+
+bool ShaderInfo::parse(const ShaderSource& source, ScanMode mode) {
+    ShaderStats::Collect collect(stats);
+    ShaderLexer::TokenStream tokens(source, mode == ScanMode::DECLARATIONS);
+
+    return ::parseTokens(tokens, *this, arena, layoutInfo, structTypes, diagnostics);
+}
+
+bool ShaderInfo::parse(StringView shaderData, const ShaderDefines& defines, ScanMode mode) {
+    ShaderStats::Collect collect(stats);
+    ShaderLexer::TokenStream tokens(shaderData, "<source>", mode == ScanMode::DECLARATIONS);
+    tokens.preprocess(defines);
+
+    return ::parseTokens(tokens, *this, arena, layoutInfo, structTypes, diagnostics);
+}
+
+bool ShaderInfo::parse(const ShaderSource& source, const ShaderDefines& defines, ScanMode mode) {
+    ShaderStats::Collect collect(stats);
+    ShaderLexer::TokenStream tokens(source, mode == ScanMode::DECLARATIONS);
+    tokens.preprocess(defines);
+
+    return ::parseTokens(tokens, *this, arena, layoutInfo, structTypes, diagnostics);
+}
+
+bool ShaderInfo::parse(ShaderLexer::TokenStream& tokens) {
+    ShaderStats::Collect collect(stats);
+    return ::parseTokens(tokens, *this, arena, layoutInfo, structTypes, diagnostics);
+}
+
+bool ShaderInfo::parseBatch(const ArrayList<String>& fileNames,
+        ArrayList<Memory::UniquePointer<ShaderInfo>>& results, ThreadPool& pool, ScanMode mode,
+        const ShaderDefines* defines, ShaderCache* cache) {
+    results.clear();
+    results.resize(fileNames.size());
+
+    std::atomic<bool> succeeded(true);
+
+    pool.parallelFor((uint32)fileNames.size(), [&](uint32 i) {
+        ShaderSource source;
+        auto shaderInfo = Memory::make_unique<ShaderInfo>();
+        ShaderStats::Collect collect(shaderInfo->getStats());
+        // ends before the collect, whose first end measures the clock rate
+        Trace::Scope scope("File", fileNames[i]);
+
+        if (!source.load(fileNames[i], IncludeCache::getGlobal())) {
+            succeeded.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        bool parsed;
+
+        if (cache != nullptr) {
+            parsed = cache->reflect(source, defines, mode, *shaderInfo);
+        }
+        else {
+            parsed = defines != nullptr ? shaderInfo->parse(source, *defines, mode)
+                    : shaderInfo->parse(source, mode);
+        }
+
+        if (!parsed) {
+            succeeded.store(false, std::memory_order_relaxed);
+        }
+
+        results[i] = std::move(shaderInfo);
+    });
+
+    return succeeded.load();
+}
+
+const ArrayList<ShaderLexer::Diagnostic>& ShaderInfo::getDiagnostics() const {
+    return diagnostics;
 }
 
 ArrayList<ShaderInfo::Layout>& ShaderInfo::getLayoutInfo() {
@@ -79,6 +266,112 @@ const ArrayList<ShaderInfo::Layout>& ShaderInfo::getLayoutInfo() const {
     return layoutInfo;
 }
 
+ArrayList<ShaderInfo::StructType>& ShaderInfo::getStructTypes() {
+    return structTypes;
+}
+
+const ArrayList<ShaderInfo::StructType>& ShaderInfo::getStructTypes() const {
+    return structTypes;
+}
+
+const ShaderInfo::StructType* ShaderInfo::findStructType(Symbol name) const {
+    for (const auto& structType : structTypes) {
+        if (structType.name == name) {
+            return &structType;
+        }
+    }
+
+    return nullptr;
+}
+
+bool ShaderInfo::getWorkgroupSize(uint32 (&size)[3]) const {
+    bool found = false;
+
+    size[0] = size[1] = size[2] = 1;
+
+    for (const auto& layout : layoutInfo) {
+        if (layout.type != LayoutType::WORKGROUP_SIZE) {
+            continue;
+        }
+
+        found = true;
+
+        for (const auto& option : layout.options) {
+            StringView optionName = getString(option.name);
+
+            if (optionName.size() == 12 && optionName.substr(0, 11) == "local_size_"
+                    && optionName[11] >= 'x' && optionName[11] <= 'z') {
+                size[optionName[11] - 'x'] = (uint32)option.value;
+            }
+        }
+    }
+
+    return found;
+}
+
+Memory::Arena& ShaderInfo::getArena() {
+    return arena;
+}
+
+StringInterner& ShaderInfo::getInterner() const {
+    return *interner;
+}
+
+StringView ShaderInfo::getString(Symbol symbol) const {
+    if ((symbol & PATH_SYMBOL_BIT) != 0) {
+        return paths[symbol & ~PATH_SYMBOL_BIT];
+    }
+
+    return interner->get(symbol);
+}
+
+ShaderInfo::Symbol ShaderInfo::internPath(StringView path) {
+    auto it = pathSymbols.find(path);
+
+    if (it != pathSymbols.end()) {
+        return it->second;
+    }
+
+    StringView stored = arena.copyString(path);
+    Symbol symbol = (Symbol)paths.size() | PATH_SYMBOL_BIT;
+
+    paths.push_back(stored);
+    pathSymbols.emplace(stored, symbol);
+
+    return symbol;
+}
+
+ShaderStats& ShaderInfo::getStats() {
+    return stats;
+}
+
+const ShaderStats& ShaderInfo::getStats() const {
+    return stats;
+}
+
+const ShaderInfo::Option* ShaderInfo::Layout::findOption(Symbol optionName) const {
+    for (const auto& option : options) {
+        if (option.name == optionName) {
+            return &option;
+        }
+    }
+
+    return nullptr;
+}
+
+const char* ShaderInfo::stringifyMemoryLayout(enum ShaderInfo::MemoryLayout memoryLayout) {
+    switch (memoryLayout) {
+        case ShaderInfo::MemoryLayout::STD140:
+            return "std140";
+        case ShaderInfo::MemoryLayout::STD430:
+            return "std430";
+        case ShaderInfo::MemoryLayout::SCALAR:
+            return "scalar";
+        default:
+            return "none";
+    }
+}
+
 const char* ShaderInfo::stringifyLayoutType(enum ShaderInfo::LayoutType type) {
 	switch (type) {
 		case ShaderInfo::LayoutType::UNIFORM_BUFFER:
@@ -91,210 +384,526 @@ const char* ShaderInfo::stringifyLayoutType(enum ShaderInfo::LayoutType type) {
 			return "Attribute Out";
 		case ShaderInfo::LayoutType::UNIFORM:
 			return "Uniform";
+		case ShaderInfo::LayoutType::PUSH_CONSTANT:
+			return "Push Constant";
+		case ShaderInfo::LayoutType::SHARED:
+			return "Shared";
+		case ShaderInfo::LayoutType::SPECIALIZATION_CONSTANT:
+			return "Specialization Constant";
+		case ShaderInfo::LayoutType::WORKGROUP_SIZE:
+			return "Workgroup Size";
 		default:
 			return "Invaild Type";
 	}
 }
 
+const char* ShaderInfo::stringifyDescriptorType(enum ShaderInfo::DescriptorType type) {
+    switch (type) {
+        case ShaderInfo::DescriptorType::SAMPLER:
+            return "Sampler";
+        case ShaderInfo::DescriptorType::COMBINED_IMAGE_SAMPLER:
+            return "Combined Image Sampler";
+        case ShaderInfo::DescriptorType::SAMPLED_IMAGE:
+            return "Sampled Image";
+        case ShaderInfo::DescriptorType::STORAGE_IMAGE:
+            return "Storage Image";
+        case ShaderInfo::DescriptorType::UNIFORM_TEXEL_BUFFER:
+            return "Uniform Texel Buffer";
+        case ShaderInfo::DescriptorType::STORAGE_TEXEL_BUFFER:
+            return "Storage Texel Buffer";
+        case ShaderInfo::DescriptorType::UNIFORM_BUFFER:
+            return "Uniform Buffer";
+        case ShaderInfo::DescriptorType::STORAGE_BUFFER:
+            return "Storage Buffer";
+        case ShaderInfo::DescriptorType::INPUT_ATTACHMENT:
+            return "Input Attachment";
+        case ShaderInfo::DescriptorType::ACCELERATION_STRUCTURE:
+            return "Acceleration Structure";
+        case ShaderInfo::DescriptorType::ATOMIC_COUNTER:
+            return "Atomic Counter";
+        default:
+            return "None";
+    }
+}
+
 namespace {
-    void tokenizeShaderSource(std::istream& fileStream, ArrayList<Token>& tokens) {
-        char c;
+    TypeTable::TypeTable(ShaderInfo& shaderInfo, ArrayList<ShaderInfo::StructType>& structTypes)
+            : shaderInfo(shaderInfo)
+            , structTypes(structTypes) {
+        // structs of earlier parses into the same ShaderInfo stay visible
+        for (uint32 i = 0; i < structTypes.size(); ++i) {
+            structIndices[structTypes[i].name] = i;
+        }
+    }
 
-        StringStream ss;
+    void TypeTable::addStruct(const ShaderInfo::StructType& structType) {
+        structIndices[structType.name] = (uint32)structTypes.size();
+        structTypes.push_back(structType);
+    }
 
-        uint32 line = 1;
+    const TypeTable::StructLayout* TypeTable::getStructLayout(uint32 index,
+            ShaderInfo::MemoryLayout memoryLayout, bool rowMajor) {
+        uint64 key = ((uint64)index << 8) | ((uint64)memoryLayout << 1) | (rowMajor ? 1 : 0);
+        auto it = structLayouts.find(key);
 
-        while (fileStream.good()) {
-            c = fileStream.peek();
+        if (it != structLayouts.end()) {
+            return it->second.get();
+        }
 
-            if (std::isalpha(c)) {
-                while (fileStream.good()) {
-                    if (std::isalnum(c) || c == '_') {
-                        ss << c;
-                    }
-                    else {
-                        break;
-                    }
+        // members of a struct can only use structs defined before it, so this can't recurse
+        // into the struct being laid out
+        const auto& structType = structTypes[index];
+        ArrayList<ShaderInfo::Variable> members(structType.members.begin(), structType.members.end());
+        auto layout = Memory::make_unique<StructLayout>();
+        uint32 end;
+        uint32 alignment;
+        uint32 unplacedMember;
+
+        if (!placeMembers(members.data(), (uint32)members.size(), structType.name, memoryLayout,
+                rowMajor, end, alignment, layout->members, unplacedMember)) {
+            layout->unplaced = unplaced;
+        }
+        else {
+            layout->alignment = ShaderMemoryLayout::getStructureAlignment(alignment, memoryLayout);
+            layout->size = (uint32)ShaderMemoryLayout::alignOffset(end, layout->alignment);
+        }
 
-                    fileStream.get();
-                    c = fileStream.peek();
-                }
+        return (structLayouts[key] = std::move(layout)).get();
+    }
 
-                Token::TokenType type;
-                String str = ss.str();
+    bool TypeTable::placeMembers(ShaderInfo::Variable* members, uint32 count, Symbol owner,
+            ShaderInfo::MemoryLayout memoryLayout, bool rowMajor, uint32& end,
+            uint32& alignment, ArrayList<ShaderInfo::Variable>& flattened,
+            uint32& unplacedMember) {
+        uint64 offset = 0;
+        uint32 maxAlignment = 1;
 
-                // TODO: coherent, volatile, restrict (https://www.khronos.org/opengl/wiki/Image_Load_Store) as memory qualifiers
-                // https://www.khronos.org/opengl/wiki/Type_Qualifier_(GLSL)#Memory_qualifiers
+        for (uint32 i = 0; i < count; ++i) {
+            auto& var = members[i];
+            ShaderMemoryLayout::TypeLayout typeLayout;
+            const StructLayout* structLayout = nullptr;
+            auto structIndex = structIndices.find(var.typeName);
 
-                if (str.compare("layout") == 0) {
-                    type = Token::TYPE_LAYOUT;
-                }
-                else if (str.compare("in") == 0) {
-                    type = Token::TYPE_IN;
-                }
-                else if (str.compare("out") == 0) {
-                    type = Token::TYPE_OUT;
-                }
-                else if (str.compare("uniform") == 0) {
-                    type = Token::TYPE_UNIFORM;
+            unplacedMember = i;
+
+            if (structIndex != structIndices.end()) {
+                structLayout = getStructLayout(structIndex->second, memoryLayout, rowMajor);
+
+                // the member of the struct that has no layout is named by its own message
+                if (!structLayout->unplaced.empty()) {
+                    unplaced = structLayout->unplaced;
+                    return false;
                 }
-                else if (str.compare("buffer") == 0) {
-                    type = Token::TYPE_BUFFER;
+
+                typeLayout = {structLayout->size, structLayout->alignment, 0};
+            }
+            else if (!ShaderMemoryLayout::getBuiltinTypeLayout(shaderInfo.getString(var.typeName),
+                    memoryLayout, rowMajor, typeLayout)) {
+                StringView typeName = shaderInfo.getString(var.typeName);
+                StringView ownerName = shaderInfo.getString(owner);
+
+                unplaced = "No memory layout for member type ";
+                unplaced.append(typeName);
+                unplaced.append(" of ");
+                unplaced.append(ownerName);
+
+                return false;
+            }
+
+            if (var.isArray && var.arraySize == 0) {
+                StringView name = shaderInfo.getString(var.name);
+                StringView ownerName = shaderInfo.getString(owner);
+
+                unplaced = "No memory layout for member ";
+                unplaced.append(name);
+                unplaced.append(" of ");
+                unplaced.append(ownerName);
+                unplaced.append(", its array size is not an integer literal");
+
+                return false;
+            }
+
+            uint64 size = typeLayout.size;
+
+            var.alignment = typeLayout.alignment;
+            var.arrayStride = 0;
+            var.matrixStride = typeLayout.matrixStride;
+
+            if (var.isArray) {
+                ShaderMemoryLayout::getArrayLayout(typeLayout, memoryLayout, var.alignment,
+                        var.arrayStride);
+                size = var.arraySize >= 0 ? (uint64)var.arrayStride * var.arraySize : 0;
+            }
+
+            uint64 memberOffset = ShaderMemoryLayout::alignOffset(offset, var.alignment);
+
+            if (memberOffset + size > UINT32_MAX) {
+                StringView name = shaderInfo.getString(var.name);
+                StringView ownerName = shaderInfo.getString(owner);
+
+                unplaced = "No memory layout for member ";
+                unplaced.append(name);
+                unplaced.append(" of ");
+                unplaced.append(ownerName);
+                unplaced.append(", it ends past the largest 32 bit offset");
+
+                return false;
+            }
+
+            var.offset = (uint32)memberOffset;
+            var.size = (uint32)size;
+            offset = memberOffset + size;
+            maxAlignment = std::max(maxAlignment, var.alignment);
+
+            if (structLayout == nullptr) {
+                flattened.push_back(var);
+                continue;
+            }
+
+            // the first element stands in for all of an unsized or large array
+            uint32 elementCount = 1;
+
+            if (var.isArray && var.arraySize > 0 && (uint64)var.arraySize
+                    * std::max<size_t>(structLayout->members.size(), 1) <= MAX_UNROLLED_MEMBERS) {
+                elementCount = (uint32)var.arraySize;
+            }
+
+            StringView name = shaderInfo.getString(var.name);
+
+            for (uint32 element = 0; element < elementCount; ++element) {
+                path.assign(name.data(), name.size());
+
+                if (var.isArray) {
+                    char digits[16];
+                    auto result = std::to_chars(digits, digits + sizeof(digits), element);
+
+                    path.push_back('[');
+                    path.append(digits, result.ptr - digits);
+                    path.push_back(']');
                 }
-                else if (str.compare("readonly") == 0 || str.compare("writeonly") == 0) {
-                    type = Token::TYPE_MEMORY_QUALIFIER;
-                } 
-                else {
-                    type = Token::TYPE_IDENTIFIER;
+
+                path.push_back('.');
+                size_t prefixLength = path.size();
+
+                for (const auto& member : structLayout->members) {
+                    StringView memberName = shaderInfo.getString(member.name);
+
+                    path.resize(prefixLength);
+                    path.append(memberName.data(), memberName.size());
+
+                    ShaderInfo::Variable leaf = member;
+                    leaf.name = shaderInfo.internPath(path);
+                    leaf.offset += var.offset + element * var.arrayStride;
+
+                    flattened.push_back(leaf);
                 }
+            }
+        }
+
+        // the padding at the end of a struct or block has to fit as well
+        if (ShaderMemoryLayout::alignOffset(offset, ShaderMemoryLayout::getStructureAlignment(
+                maxAlignment, memoryLayout)) > UINT32_MAX) {
+            StringView ownerName = shaderInfo.getString(owner);
+
+            unplaced = "No memory layout for ";
+            unplaced.append(ownerName);
+            unplaced.append(", its size is past the largest 32 bit offset");
+
+            return false;
+        }
+
+        end = (uint32)offset;
+        alignment = maxAlignment;
+
+        return true;
+    }
+
+    LayoutBuilder::LayoutBuilder(StringInterner& interner)
+            : interner(interner)
+            , std140Symbol(interner.intern("std140"))
+            , std430Symbol(interner.intern("std430"))
+            , scalarSymbol(interner.intern("scalar"))
+            , rowMajorSymbol(interner.intern("row_major"))
+            , pushConstantSymbol(interner.intern("push_constant")) {}
+
+    void LayoutBuilder::clear() {
+        type = ShaderInfo::LayoutType::INVALID;
+        memoryLayout = ShaderInfo::MemoryLayout::NONE;
+
+        options.clear();
+        memoryQualifiers.clear();
+        name = StringInterner::EMPTY_SYMBOL;
+        typeQualifier = StringInterner::EMPTY_SYMBOL;
+
+        descriptorType = ShaderInfo::DescriptorType::NONE;
+        imageFormat = StringInterner::EMPTY_SYMBOL;
+        isArray = false;
+        arraySize = 0;
+        defaultValue = StringInterner::EMPTY_SYMBOL;
+
+        body.clear();
+        flattenedBody.clear();
+        blockSize = 0;
+        unsizedArrayStride = 0;
+        memberTokens.clear();
+    }
+
+    bool LayoutBuilder::hasOption(Symbol optionName) const {
+        for (const auto& option : options) {
+            if (option.name == optionName) {
+                return true;
+            }
+        }
 
-                tokens.push_back({type, str, line});
-                ss.str("");
+        return false;
+    }
+
+    void LayoutBuilder::setOption(Symbol optionName, int32 value) {
+        for (auto& option : options) {
+            if (option.name == optionName) {
+                option.value = value;
+                return;
             }
-            else if (std::isdigit(c)) {
-                while (fileStream.good()) {
-                    if (std::isdigit(c) || c == 'x' || c == 'X' || c == 'f' || c == '.') {
-                        ss << c;
-                    }
-                    else {
-                        break;
-                    }
+        }
 
-                    fileStream.get();
-                    c = fileStream.peek();
-                }
+        options.push_back({optionName, value});
+    }
 
-                tokens.push_back({Token::TYPE_NUMERIC, ss.str(), line});
-                ss.str("");
+    bool LayoutBuilder::hasWorkgroupSize() const {
+        for (const auto& option : options) {
+            if (interner.get(option.name).substr(0, 11) == "local_size_") {
+                return true;
             }
-            else if (std::isspace(c)) {
-                while (fileStream.good()) {
-                    if (c == '\n') {
-                        ++line;
-                    }
-                    else if (!std::isspace(c)) {
-                        break;
-                    }
+        }
+
+        return false;
+    }
+
+    bool LayoutBuilder::computeMemoryLayout(TypeTable& types, ShaderLexer::TokenStream& tokens) {
+        ShaderStats::Timer timer(ShaderStats::PHASE_MEMORY_LAYOUT);
+
+        // without a layout qualifier blocks get the Vulkan defaults
+        if (hasOption(std430Symbol)) {
+            memoryLayout = ShaderInfo::MemoryLayout::STD430;
+        }
+        else if (hasOption(scalarSymbol)) {
+            memoryLayout = ShaderInfo::MemoryLayout::SCALAR;
+        }
+        else if (hasOption(std140Symbol) || type == ShaderInfo::LayoutType::UNIFORM_BUFFER) {
+            memoryLayout = ShaderInfo::MemoryLayout::STD140;
+        }
+        else {
+            memoryLayout = ShaderInfo::MemoryLayout::STD430;
+        }
+
+        bool rowMajor = hasOption(rowMajorSymbol);
+        uint32 end;
+        uint32 maxAlignment;
+        uint32 unplacedMember;
+
+        if (!types.placeMembers(body.data(), (uint32)body.size(), name, memoryLayout, rowMajor,
+                end, maxAlignment, flattenedBody, unplacedMember)) {
+            tokens.warn(&memberTokens[unplacedMember], "%s", types.unplaced.c_str());
+
+            memoryLayout = ShaderInfo::MemoryLayout::NONE;
+            flattenedBody.clear();
 
-                    fileStream.get();
-                    c = fileStream.peek();
+            return false;
+        }
+
+        // a trailing unsized array starts right where the fixed part of the block ends
+        if (!body.empty() && body.back().isArray && body.back().arraySize < 0) {
+            unsizedArrayStride = body.back().arrayStride;
+            blockSize = body.back().offset;
+        }
+        else {
+            blockSize = (uint32)ShaderMemoryLayout::alignOffset(end,
+                    ShaderMemoryLayout::getStructureAlignment(maxAlignment, memoryLayout));
+        }
+
+        return true;
+    }
+
+    ShaderInfo::Layout LayoutBuilder::build(Memory::Arena& arena) const {
+        ShaderInfo::Layout li;
+        li.type = type;
+        li.memoryLayout = memoryLayout;
+
+        li.options = arena.copyArray(options.data(), (uint32)options.size());
+        li.memoryQualifiers = arena.copyArray(memoryQualifiers.data(), (uint32)memoryQualifiers.size());
+        li.name = name;
+        li.typeQualifier = typeQualifier;
+        li.descriptorType = descriptorType;
+        li.imageFormat = imageFormat;
+        li.isArray = isArray;
+        li.arraySize = arraySize;
+        li.defaultValue = defaultValue;
+        li.body = arena.copyArray(body.data(), (uint32)body.size());
+        li.flattenedBody = arena.copyArray(flattenedBody.data(), (uint32)flattenedBody.size());
+        li.blockSize = blockSize;
+        li.unsizedArrayStride = unsizedArrayStride;
+
+        return li;
+    }
+
+    bool parseTokens(ShaderLexer::TokenStream& tokens, ShaderInfo& shaderInfo,
+            Memory::Arena& arena, ArrayList<ShaderInfo::Layout>& layoutInfo,
+            ArrayList<ShaderInfo::StructType>& structTypes,
+            ArrayList<ShaderLexer::Diagnostic>& diagnostics) {
+        ShaderStats::Timer timer(ShaderStats::PHASE_PARSE);
+        Trace::Scope scope("Parse");
+
+        LayoutBuilder li(shaderInfo.getInterner());
+        TypeTable types(shaderInfo, structTypes);
+        // braces of function bodies, structs declared inside them are local
+        uint32 depth = 0;
+        bool failed = false;
+
+        tokens.setDiagnostics(&diagnostics);
+
+        while (const Token* token = tokens.next()) {
+            if (token->type == Token::TYPE_LAYOUT) {
+                li.clear();
+
+                if (!::consumeLayout(tokens, li, types)) {
+                    failed = true;
+                    ::synchronize(tokens);
+
+                    continue;
                 }
+
+                layoutInfo.push_back(li.build(arena));
             }
-            else {
-                fileStream.get();
-
-                Token::TokenType type;
-
-                switch (c) {
-                    case '(':
-                        type = Token::TYPE_OPEN_PAREN;
-                        break;
-                    case ')':
-                        type = Token::TYPE_CLOSE_PAREN;
-                        break;
-                    case '#':
-                        type = Token::TYPE_POUND_SIGN;
-                        break;
-                    case '=':
-                        type = Token::TYPE_EQUAL_SIGN;
-                        break;
-                    case ',':
-                        type = Token::TYPE_COMMA;
-                        break;
-                    case ';':
-                        type = Token::TYPE_SEMI_COLON;
-                        break;
-                    case '{':
-                        type = Token::TYPE_OPEN_CURLY;
-                        break;
-                    case '}':
-                        type = Token::TYPE_CLOSE_CURLY;
-                        break;
-                    case '[':
-                        type = Token::TYPE_OPEN_SQUARE;
-                        break;
-                    case ']':
-                        type = Token::TYPE_CLOSE_SQUARE;
-                        break;
-                    default:
-                        type = Token::TYPE_OPERATOR;
+            else if (token->type == Token::TYPE_OPEN_CURLY) {
+                ++depth;
+            }
+            else if (token->type == Token::TYPE_CLOSE_CURLY && depth > 0) {
+                --depth;
+            }
+            else if (token->type == Token::TYPE_KEYWORD && token->data == "struct" && depth == 0) {
+                li.clear();
+
+                if (!::consumeStruct(tokens, li, types, arena)) {
+                    failed = true;
+                    ::synchronize(tokens);
                 }
+            }
+            else if (token->type == Token::TYPE_QUALIFIER && token->data == "shared" && depth == 0) {
+                li.clear();
 
-                tokens.push_back({type, String(&c, 1), line});
+                if (!::consumeShared(tokens, li, arena, layoutInfo)) {
+                    failed = true;
+                    ::synchronize(tokens);
+                }
             }
         }
 
-        // rewind the stream, not strictly necessary
-        //fileStream.clear();
-        //fileStream.seekg(0);
+        return !failed && !tokens.hasError();
     }
 
-	bool consumeLayout(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-			ArrayList<ShaderInfo::Layout>& layoutInfo) {
-		if (!::expect(++it, end, Token::TYPE_OPEN_PAREN)) {
+	bool consumeLayout(ShaderLexer::TokenStream& tokens, LayoutBuilder& li, TypeTable& types) {
+		ShaderStats::Timer timer(ShaderStats::PHASE_LAYOUT);
+
+		const Token* token;
+
+		if (!::expect(tokens, token, Token::TYPE_OPEN_PAREN)) {
 			return false;
 		}
 
-		ShaderInfo::Layout li;
-
-		if (!::consumeLayoutOptions(it, end, li)) {
+		if (!::consumeLayoutOptions(tokens, li)) {
 			return false;
 		}
 
-		if (!::consumeLayoutQualifiers(it, end, li)) {
+		if (!::consumeLayoutQualifiers(tokens, li)) {
 			return false;
 		}
 
+		switch (li.type) {
+			case ShaderInfo::LayoutType::UNIFORM_BUFFER:
+				if (li.hasOption(li.pushConstantSymbol)) {
+					li.type = ShaderInfo::LayoutType::PUSH_CONSTANT;
+				}
+				else {
+					li.descriptorType = ShaderInfo::DescriptorType::UNIFORM_BUFFER;
+				}
+
+				break;
+			case ShaderInfo::LayoutType::SHADER_STORAGE_BUFFER:
+				li.descriptorType = ShaderInfo::DescriptorType::STORAGE_BUFFER;
+				break;
+			case ShaderInfo::LayoutType::UNIFORM:
+				li.descriptorType = ::getDescriptorType(li.interner.get(li.typeQualifier));
+				break;
+			default:
+				break;
+		}
+
 		if (li.type == ShaderInfo::LayoutType::UNIFORM_BUFFER
-				|| li.type == ShaderInfo::LayoutType::SHADER_STORAGE_BUFFER) {
-			if (!::consumeLayoutVariables(it, end, li)) {
+				|| li.type == ShaderInfo::LayoutType::SHADER_STORAGE_BUFFER
+				|| li.type == ShaderInfo::LayoutType::PUSH_CONSTANT) {
+			if (!::consumeLayoutVariables(tokens, li)) {
 				return false;
 			}
-		}
 
-		layoutInfo.push_back(li);
+			// a member without a known layout leaves the block without offsets, not unparsed
+			li.computeMemoryLayout(types, tokens);
+		}
 
 		return true;
 	}
 
-    bool consumeLayoutOptions(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            ShaderInfo::Layout& li) {
+    bool consumeLayoutOptions(ShaderLexer::TokenStream& tokens, LayoutBuilder& li) {
+        ShaderStats::Timer timer(ShaderStats::PHASE_LAYOUT_OPTIONS);
+
+        const Token* token;
+
         bool parsing = true;
 
         while (parsing) {
-            if (!::expect(++it, end, Token::TYPE_IDENTIFIER)) {
+            // shared is the only layout qualifier that is also a keyword
+            if (!::expect(tokens, token, {Token::TYPE_IDENTIFIER, Token::TYPE_QUALIFIER})) {
                 return false;
             }
 
-            String ident = it->data;
+            Symbol ident = li.intern(*token);
+            StringView identName = token->data;
 
-            if (!::expect(++it, end, {Token::TYPE_EQUAL_SIGN, Token::TYPE_COMMA, Token::TYPE_CLOSE_PAREN})) {
+            if (!::expect(tokens, token, {Token::TYPE_EQUAL_SIGN, Token::TYPE_COMMA, Token::TYPE_CLOSE_PAREN})) {
                 return false;
             }
 
-            switch (it->type) {
+            switch (token->type) {
                 case Token::TYPE_EQUAL_SIGN:
-                    if (!::expect(++it, end, Token::TYPE_NUMERIC)) {
+                    if (!::expect(tokens, token, Token::TYPE_NUMERIC)) {
                         return false;
                     }
 
-                    li.options[ident] = std::stoi(it->data);
+                    int32 value;
 
-                    if (!::expect(++it, end, {Token::TYPE_COMMA, Token::TYPE_CLOSE_PAREN})) {
+                    if (!::parseInteger(tokens, *token, value)) {
                         return false;
                     }
 
-                    if (it->type == Token::TYPE_CLOSE_PAREN) {
+                    li.setOption(ident, value);
+
+                    if (!::expect(tokens, token, {Token::TYPE_COMMA, Token::TYPE_CLOSE_PAREN})) {
+                        return false;
+                    }
+
+                    if (token->type == Token::TYPE_CLOSE_PAREN) {
                         parsing = false;
                     }
 
                     break;
                 case Token::TYPE_COMMA:
-                    li.options[ident] = 0;
-                    break;
                 case Token::TYPE_CLOSE_PAREN:
-                    li.options[ident] = 0;
-                    parsing = false;
+                    li.setOption(ident, 0);
+
+                    if (::isImageFormat(identName)) {
+                        li.imageFormat = ident;
+                    }
+
+                    parsing = token->type == Token::TYPE_COMMA;
                     break;
             }
         }
@@ -302,23 +911,33 @@ namespace {
         return true;
     }
 
-	bool consumeLayoutQualifiers(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-			ShaderInfo::Layout& li) {
-		if (!::expect(++it, end, {Token::TYPE_MEMORY_QUALIFIER, Token::TYPE_IN, Token::TYPE_OUT,
-				Token::TYPE_UNIFORM, Token::TYPE_BUFFER})) {
+	bool consumeLayoutQualifiers(ShaderLexer::TokenStream& tokens, LayoutBuilder& li) {
+		ShaderStats::Timer timer(ShaderStats::PHASE_LAYOUT_QUALIFIERS);
+
+		const Token* token;
+
+		if (!::expect(tokens, token, {Token::TYPE_MEMORY_QUALIFIER, Token::TYPE_IN, Token::TYPE_OUT,
+				Token::TYPE_UNIFORM, Token::TYPE_BUFFER, Token::TYPE_QUALIFIER})) {
 			return false;
 		}
 
-		while (it->type == Token::TYPE_MEMORY_QUALIFIER) {
-			li.memoryQualifiers.push_back(it->data);
+		while (token->type == Token::TYPE_MEMORY_QUALIFIER || token->type == Token::TYPE_QUALIFIER) {
+			if (token->data == "const") {
+				return ::consumeSpecializationConstant(tokens, li);
+			}
+
+			// interpolation, precision and invariance qualifiers don't change the interface
+			if (token->type == Token::TYPE_MEMORY_QUALIFIER) {
+				li.memoryQualifiers.push_back(li.intern(*token));
+			}
 			
-			if (!::expect(++it, end, {Token::TYPE_MEMORY_QUALIFIER, Token::TYPE_IN, Token::TYPE_OUT,
-					Token::TYPE_UNIFORM, Token::TYPE_BUFFER})) {
+			if (!::expect(tokens, token, {Token::TYPE_MEMORY_QUALIFIER, Token::TYPE_IN, Token::TYPE_OUT,
+					Token::TYPE_UNIFORM, Token::TYPE_BUFFER, Token::TYPE_QUALIFIER})) {
 				return false;
 			}
 		}
 
-		switch (it->type) {
+		switch (token->type) {
 			case Token::TYPE_IN:
 				li.type = ShaderInfo::LayoutType::ATTRIB_IN;
 				break;
@@ -326,7 +945,7 @@ namespace {
 				li.type = ShaderInfo::LayoutType::ATTRIB_OUT;
 				break;
 			case Token::TYPE_UNIFORM:
-				li.type = li.options.find("std140") != li.options.end()
+				li.type = li.hasOption(li.std140Symbol)
 						? ShaderInfo::LayoutType::UNIFORM_BUFFER : ShaderInfo::LayoutType::UNIFORM;
 				break;
 			case Token::TYPE_BUFFER:
@@ -334,182 +953,470 @@ namespace {
 				break;
 		}
 
+		// uniform writeonly image2D, the qualifiers can come in any order
+		for (const Token* next = tokens.peek(); next != nullptr
+				&& (next->type == Token::TYPE_MEMORY_QUALIFIER || next->type == Token::TYPE_QUALIFIER);
+				next = tokens.peek()) {
+			token = tokens.next();
+
+			if (token->type == Token::TYPE_MEMORY_QUALIFIER) {
+				li.memoryQualifiers.push_back(li.intern(*token));
+			}
+		}
+
         if (li.type == ShaderInfo::LayoutType::ATTRIB_IN) {
-            if (!::expect(++it, end, {Token::TYPE_IDENTIFIER, Token::TYPE_SEMI_COLON})) {
+            if (!::expect(tokens, token, {Token::TYPE_IDENTIFIER, Token::TYPE_BUILTIN_TYPE,
+                    Token::TYPE_SEMI_COLON})) {
                 return false;
             }
 
-            if (it->type == Token::TYPE_IDENTIFIER) {
-                li.typeQualifier = it->data;
+            if (token->type != Token::TYPE_SEMI_COLON) {
+                li.typeQualifier = li.intern(*token);
             }
             else {
+                // the other layouts without a variable set up geometry and tessellation
+                if (li.hasWorkgroupSize()) {
+                    li.type = ShaderInfo::LayoutType::WORKGROUP_SIZE;
+                }
+
                 return true;
             }
         }
 		else if (li.type == ShaderInfo::LayoutType::ATTRIB_OUT
 				|| li.type == ShaderInfo::LayoutType::UNIFORM) {
-			if (!::expect(++it, end, Token::TYPE_IDENTIFIER)) {
+			if (!::expect(tokens, token, {Token::TYPE_IDENTIFIER, Token::TYPE_BUILTIN_TYPE})) {
 				return false;
 			}
 
-			li.typeQualifier = it->data;
+			// a uniform block without std140, the identifier is the block name
+			if (li.type == ShaderInfo::LayoutType::UNIFORM && token->type == Token::TYPE_IDENTIFIER) {
+				const Token* next = tokens.peek();
+
+				if (next != nullptr && next->type == Token::TYPE_OPEN_CURLY) {
+					li.type = ShaderInfo::LayoutType::UNIFORM_BUFFER;
+					li.name = li.intern(*token);
+
+					return true;
+				}
+			}
+
+			li.typeQualifier = li.intern(*token);
 		}
 
 		// TODO: I think the buffer name is actually optional for UBOs and SSBOs
-		if (!::expect(++it, end, Token::TYPE_IDENTIFIER)) {
+		if (!::expect(tokens, token, Token::TYPE_IDENTIFIER)) {
 			return false;
 		}
 
-		li.name = it->data;
+		li.name = li.intern(*token);
 
-		return true;
+		// the rest of a declaration of several variables is skipped
+		return ::consumeArraySize(tokens, li.isArray, li.arraySize);
 	}
 
-	bool consumeLayoutVariables(ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-			ShaderInfo::Layout& li) {
-		if (!::expect(++it, end, Token::TYPE_OPEN_CURLY)) {
+	bool consumeLayoutVariables(ShaderLexer::TokenStream& tokens, LayoutBuilder& li) {
+		ShaderStats::Timer timer(ShaderStats::PHASE_LAYOUT_VARIABLES);
+
+		const Token* token;
+
+		if (!::consumeMembers(tokens, li, li.body)) {
 			return false;
 		}
 
-		ShaderInfo::Variable var;
+		// the instance name, an array of instances takes a descriptor per element
+		const Token* next = tokens.peek();
+
+		if (next != nullptr && next->type == Token::TYPE_IDENTIFIER) {
+			tokens.next();
 
-		while (it->type != Token::TYPE_CLOSE_CURLY) {
-			if (!::expect(++it, end, {Token::TYPE_IDENTIFIER, Token::TYPE_CLOSE_CURLY})) {
+			if (!::consumeArraySize(tokens, li.isArray, li.arraySize)) {
 				return false;
 			}
+		}
 
-			if (it->type == Token::TYPE_CLOSE_CURLY) {
-				break;
-			}
+		return ::expect(tokens, token, Token::TYPE_SEMI_COLON);
+	}
 
-			var.typeName = it->data;
+	bool consumeSpecializationConstant(ShaderLexer::TokenStream& tokens, LayoutBuilder& li) {
+		const Token* token;
 
-			if (!::expect(++it, end, Token::TYPE_IDENTIFIER)) {
-				return false;
-			}
+		li.type = ShaderInfo::LayoutType::SPECIALIZATION_CONSTANT;
+
+		if (!::expect(tokens, token, {Token::TYPE_BUILTIN_TYPE, Token::TYPE_IDENTIFIER})) {
+			return false;
+		}
 
-			var.name = it->data;
+		li.typeQualifier = li.intern(*token);
 
-			if (!::expect(++it, end, {Token::TYPE_OPEN_SQUARE, Token::TYPE_SEMI_COLON})) {
-				return false;
-			}
+		if (!::expect(tokens, token, Token::TYPE_IDENTIFIER)) {
+			return false;
+		}
 
-			if (it->type == Token::TYPE_OPEN_SQUARE) {
-				var.isArray = true;
+		li.name = li.intern(*token);
 
-				if (!::expect(++it, end, {Token::TYPE_NUMERIC, Token::TYPE_CLOSE_SQUARE})) {
-					return false;
-				}
+		if (!::expect(tokens, token, Token::TYPE_EQUAL_SIGN)) {
+			return false;
+		}
 
-				if (it->type == Token::TYPE_NUMERIC) {
-					var.arraySize = std::stoi(it->data);
+		const Token* next = tokens.peek();
+		bool negative = next != nullptr && next->type == Token::TYPE_OPERATOR && next->data == "-";
 
-					if (!::expect(++it, end, Token::TYPE_CLOSE_SQUARE)) {
-						return false;
-					}
-				}
-				else {
-					var.arraySize = -1;
-				}
+		if (negative) {
+			tokens.next();
+		}
 
-				if (!::expect(++it, end, Token::TYPE_SEMI_COLON)) {
-					return false;
-				}
+		if (!::expect(tokens, token, {Token::TYPE_NUMERIC, Token::TYPE_KEYWORD})) {
+			return false;
+		}
+
+		if (token->type == Token::TYPE_KEYWORD && token->data != "true" && token->data != "false") {
+			tokens.report(token, "Specialization constant %.*s needs a literal default value",
+					(int)token->data.size(), token->data.data());
+			return false;
+		}
+
+		if (negative) {
+			String value("-");
+			value.append(token->data.data(), token->data.size());
+
+			li.defaultValue = li.interner.intern(value);
+		}
+		else {
+			li.defaultValue = li.intern(*token);
+		}
+
+		return ::expect(tokens, token, Token::TYPE_SEMI_COLON);
+	}
+
+	bool consumeArraySize(ShaderLexer::TokenStream& tokens, bool& isArray, int32& arraySize) {
+		const Token* token = tokens.peek();
+
+		isArray = false;
+		arraySize = 0;
+
+		if (token == nullptr || token->type != Token::TYPE_OPEN_SQUARE) {
+			return true;
+		}
+
+		tokens.next();
+
+		// a copy, the stream reuses the storage of the tokens it returns
+		Token size;
+		uint32 sizeTokens = 0;
+
+		while (true) {
+			const Token* next = tokens.peek();
+
+			if (next == nullptr || next->type == Token::TYPE_SEMI_COLON) {
+				// reports the missing ]
+				return ::expect(tokens, token, Token::TYPE_CLOSE_SQUARE);
 			}
-			else {
-				var.isArray = false;
+
+			token = tokens.next();
+
+			if (token->type == Token::TYPE_CLOSE_SQUARE) {
+				break;
 			}
 
-			li.body.push_back(var);
+			size = *token;
+			++sizeTokens;
+		}
+
+		isArray = true;
+
+		if (sizeTokens == 0) {
+			arraySize = -1;
+		}
+		// sized by a constant or an expression
+		else if (sizeTokens > 1 || size.type != Token::TYPE_NUMERIC) {
+			arraySize = 0;
+		}
+		else if (!::parseInteger(tokens, size, arraySize)) {
+			return false;
+		}
+
+		return true;
+	}
+
+	bool consumeShared(ShaderLexer::TokenStream& tokens, LayoutBuilder& li,
+			Memory::Arena& arena, ArrayList<ShaderInfo::Layout>& layoutInfo) {
+		ShaderStats::Timer timer(ShaderStats::PHASE_LAYOUT);
+
+		const Token* token;
+
+		li.type = ShaderInfo::LayoutType::SHARED;
+
+		if (!::expect(tokens, token, {Token::TYPE_BUILTIN_TYPE, Token::TYPE_IDENTIFIER})) {
+			return false;
 		}
 
+		li.typeQualifier = li.intern(*token);
+
 		do {
-			if (!::expect(++it, end, {Token::TYPE_SEMI_COLON, Token::TYPE_IDENTIFIER})) {
+			if (!::expect(tokens, token, Token::TYPE_IDENTIFIER)) {
+				return false;
+			}
+
+			li.name = li.intern(*token);
+
+			if (!::consumeArraySize(tokens, li.isArray, li.arraySize)) {
+				return false;
+			}
+
+			layoutInfo.push_back(li.build(arena));
+
+			if (!::expect(tokens, token, {Token::TYPE_SEMI_COLON, Token::TYPE_COMMA})) {
 				return false;
 			}
 		}
-		while (it->type != Token::TYPE_SEMI_COLON);
+		while (token->type == Token::TYPE_COMMA);
 
 		return true;
 	}
 
-    bool expect(const ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
-            Token::TokenType type) {
-        if (it == end) {
-            DEBUG_LOG("Shader Parser", LOG_ERROR, "Unexpected token: expected %s got EOF",
-                    ::stringifyTokenType(type));
+    bool consumeStruct(ShaderLexer::TokenStream& tokens, LayoutBuilder& li, TypeTable& types,
+            Memory::Arena& arena) {
+        ShaderStats::Timer timer(ShaderStats::PHASE_STRUCT);
+
+        const Token* token;
+
+        if (!::expect(tokens, token, Token::TYPE_IDENTIFIER)) {
             return false;
         }
-        else if (it->type != type) {
-            DEBUG_LOG("Shader Parser", LOG_ERROR, "Unexpected token: expected %s got %s (line %d)",
-                    ::stringifyTokenType(type), ::stringifyTokenType(it->type), it->line);
+
+        li.name = li.intern(*token);
+
+        if (types.structIndices.count(li.name) != 0) {
+            tokens.report(token, "Redefinition of struct %.*s", (int)token->data.size(),
+                    token->data.data());
             return false;
         }
 
+        if (!::consumeMembers(tokens, li, li.body)) {
+            return false;
+        }
+
+        // variables declared along with the struct are not part of the interface
+        do {
+            if (!::expect(tokens, token, {Token::TYPE_SEMI_COLON, Token::TYPE_IDENTIFIER,
+                    Token::TYPE_COMMA, Token::TYPE_OPEN_SQUARE, Token::TYPE_NUMERIC,
+                    Token::TYPE_CLOSE_SQUARE})) {
+                return false;
+            }
+        }
+        while (token->type != Token::TYPE_SEMI_COLON);
+
+        types.addStruct({li.name, arena.copyArray(li.body.data(), (uint32)li.body.size())});
+
         return true;
     }
 
-    bool expect(const ArrayList<Token>::iterator& it, const ArrayList<Token>::iterator& end,
+	bool consumeMembers(ShaderLexer::TokenStream& tokens, LayoutBuilder& li,
+			ArrayList<ShaderInfo::Variable>& members) {
+		ShaderStats::Timer timer(ShaderStats::PHASE_MEMBERS);
+
+		const Token* token;
+
+		if (!::expect(tokens, token, Token::TYPE_OPEN_CURLY)) {
+			return false;
+		}
+
+		ShaderInfo::Variable var = {};
+
+		while (token->type != Token::TYPE_CLOSE_CURLY) {
+			if (!::expect(tokens, token, {Token::TYPE_IDENTIFIER, Token::TYPE_BUILTIN_TYPE,
+					Token::TYPE_CLOSE_CURLY})) {
+				return false;
+			}
+
+			if (token->type == Token::TYPE_CLOSE_CURLY) {
+				break;
+			}
+
+			var.typeName = li.intern(*token);
+
+			// float a, b[2]; declares a member per name
+			do {
+				if (!::expect(tokens, token, Token::TYPE_IDENTIFIER)) {
+					return false;
+				}
+
+				var.name = li.intern(*token);
+				li.memberTokens.push_back(*token);
+
+				// a size the parser can't evaluate leaves the block without offsets
+				if (!::consumeArraySize(tokens, var.isArray, var.arraySize)) {
+					return false;
+				}
+
+				if (!::expect(tokens, token, {Token::TYPE_SEMI_COLON, Token::TYPE_COMMA})) {
+					return false;
+				}
+
+				members.push_back(var);
+			}
+			while (token->type == Token::TYPE_COMMA);
+		}
+
+		return true;
+	}
+
+    bool expect(ShaderLexer::TokenStream& tokens, const Token*& token, Token::TokenType type) {
+        return ::expect(tokens, token, {type});
+    }
+
+    bool expect(ShaderLexer::TokenStream& tokens, const Token*& token,
             std::initializer_list<Token::TokenType> types) {
-        if (it == end) {
-            DEBUG_LOG("Shader Parser", LOG_ERROR, "Unexpected token: expected token got EOF");
+        const Token* next = tokens.peek();
+
+        if (next == nullptr) {
+            // the preprocessor has reported why the stream ended already
+            if (!tokens.hasError()) {
+                tokens.report(nullptr, "Unexpected token: expected %s got EOF",
+                        ShaderLexer::stringifyTokenType(*types.begin()));
+            }
+
             return false;
         }
 
         for (auto& type : types) {
-            if (it->type == type) {
+            if (next->type == type) {
+                token = tokens.next();
                 return true;
             }
         }
 
-        DEBUG_LOG("Shader Parser", LOG_ERROR, "Unexpected token: expected %s got %s (line %d)",
-                ::stringifyTokenType(*types.begin()), ::stringifyTokenType(it->type), it->line);
+        tokens.report(next, "Unexpected token: expected %s got %s",
+                ShaderLexer::stringifyTokenType(*types.begin()),
+                ShaderLexer::stringifyTokenType(next->type));
 
         return false;
     }
 
-    const char* stringifyTokenType(enum Token::TokenType type) {
-        switch (type) {
-            case Token::TYPE_IDENTIFIER:
-                return "identifier";
-            case Token::TYPE_NUMERIC:
-                return "numeric literal";
-            case Token::TYPE_OPERATOR:
-                return "operator";
-            case Token::TYPE_LAYOUT:
-                return "layout";
-            case Token::TYPE_IN:
-                return "in";
-            case Token::TYPE_OUT:
-                return "out";
-            case Token::TYPE_UNIFORM:
-                return "uniform";
-            case Token::TYPE_BUFFER:
-                return "buffer";
-            case Token::TYPE_MEMORY_QUALIFIER:
-                return "memory qualifier";
-            case Token::TYPE_OPEN_PAREN:
-                return "(";
-            case Token::TYPE_CLOSE_PAREN:
-                return ")";
-            case Token::TYPE_POUND_SIGN:
-                return "#";
-            case Token::TYPE_EQUAL_SIGN:
-                return "=";
-            case Token::TYPE_COMMA:
-                return ",";
-            case Token::TYPE_SEMI_COLON:
-                return ";";
-            case Token::TYPE_OPEN_CURLY:
-                return "{";
-            case Token::TYPE_CLOSE_CURLY:
-                return "}";
-            case Token::TYPE_OPEN_SQUARE:
-                return "[";
-            case Token::TYPE_CLOSE_SQUARE:
-                return "]";
-            default:
-                return "invalid token";
+    void synchronize(ShaderLexer::TokenStream& tokens) {
+        uint32 depth = 0;
+
+        while (const Token* token = tokens.peek()) {
+            if (depth == 0 && (token->type == Token::TYPE_LAYOUT
+                    || (token->type == Token::TYPE_KEYWORD && token->data == "struct"))) {
+                return;
+            }
+
+            token = tokens.next();
+
+            if (token->type == Token::TYPE_OPEN_CURLY) {
+                ++depth;
+            }
+            else if (token->type == Token::TYPE_CLOSE_CURLY) {
+                if (depth == 0) {
+                    return;
+                }
+
+                --depth;
+            }
+            else if (token->type == Token::TYPE_SEMI_COLON && depth == 0) {
+                return;
+            }
+        }
+    }
+
+    bool parseInteger(ShaderLexer::TokenStream& tokens, const Token& token, int32& value) {
+        const char* first = token.data.data();
+        const char* last = first + token.data.size();
+        int base = 10;
+
+        if (token.data.size() > 2 && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) {
+            first += 2;
+            base = 16;
+        }
+
+        // unsigned literals are allowed for sizes and options
+        if (last - first > 1 && (last[-1] == 'u' || last[-1] == 'U')) {
+            --last;
+        }
+
+        auto result = std::from_chars(first, last, value, base);
+
+        // 1.5 or 4e2 stop the conversion early, they are not integers
+        if (result.ec != std::errc() || result.ptr != last) {
+            tokens.report(&token, "Invalid integer literal: %.*s", (int)token.data.size(),
+                    token.data.data());
+            return false;
+        }
+
+        return true;
+    }
+
+    ShaderInfo::DescriptorType getDescriptorType(StringView typeName) {
+        // the i and u prefixed types bind the same way
+        auto hasPrefix = [&](StringView prefix) {
+            return typeName.substr(0, prefix.size()) == prefix
+                    || ((typeName[0] == 'i' || typeName[0] == 'u')
+                    && typeName.substr(1, prefix.size()) == prefix);
+        };
+
+        if (typeName.empty()) {
+            return ShaderInfo::DescriptorType::NONE;
+        }
+
+        bool buffer = typeName.size() >= 6 && typeName.substr(typeName.size() - 6) == "Buffer";
+
+        if (typeName == "sampler" || typeName == "samplerShadow") {
+            return ShaderInfo::DescriptorType::SAMPLER;
+        }
+
+        if (hasPrefix("sampler")) {
+            return buffer ? ShaderInfo::DescriptorType::UNIFORM_TEXEL_BUFFER
+                    : ShaderInfo::DescriptorType::COMBINED_IMAGE_SAMPLER;
+        }
+
+        if (hasPrefix("texture")) {
+            return buffer ? ShaderInfo::DescriptorType::UNIFORM_TEXEL_BUFFER
+                    : ShaderInfo::DescriptorType::SAMPLED_IMAGE;
+        }
+
+        if (hasPrefix("image")) {
+            return buffer ? ShaderInfo::DescriptorType::STORAGE_TEXEL_BUFFER
+                    : ShaderInfo::DescriptorType::STORAGE_IMAGE;
+        }
+
+        if (hasPrefix("subpassInput")) {
+            return ShaderInfo::DescriptorType::INPUT_ATTACHMENT;
+        }
+
+        if (typeName == "accelerationStructureEXT") {
+            return ShaderInfo::DescriptorType::ACCELERATION_STRUCTURE;
+        }
+
+        if (typeName == "atomic_uint") {
+            return ShaderInfo::DescriptorType::ATOMIC_COUNTER;
         }
+
+        return ShaderInfo::DescriptorType::NONE;
+    }
+
+    bool isImageFormat(StringView option) {
+        // GLSL 4.60 section 4.4.7 and the 64 bit formats of GL_EXT_shader_image_int64
+        static constexpr const char* FORMATS[] = {
+            "rgba32f", "rgba16f", "rg32f", "rg16f", "r11f_g11f_b10f", "r32f", "r16f",
+            "rgba16", "rgb10_a2", "rgba8", "rg16", "rg8", "r16", "r8",
+            "rgba16_snorm", "rgba8_snorm", "rg16_snorm", "rg8_snorm", "r16_snorm", "r8_snorm",
+            "rgba32i", "rgba16i", "rgba8i", "rg32i", "rg16i", "rg8i", "r32i", "r16i", "r8i",
+            "rgba32ui", "rgba16ui", "rgb10_a2ui", "rgba8ui", "rg32ui", "rg16ui", "rg8ui",
+            "r32ui", "r16ui", "r8ui", "r64ui", "r64i"
+        };
+
+        // every format starts with r
+        if (option.empty() || option[0] != 'r') {
+            return false;
+        }
+
+        for (const char* format : FORMATS) {
+            if (option == format) {
+                return true;
+            }
+        }
+
+        return false;
     }
 };
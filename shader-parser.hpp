@@ -2,17 +2,60 @@
 
 #include <engine/core/common.hpp>
 #include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
 
+#include <engine/core/arena.hpp>
 #include <engine/core/array-list.hpp>
 #include <engine/core/hash-map.hpp>
+#include <engine/core/memory.hpp>
+#include <engine/core/string-interner.hpp>
 
+#include "shader-lexer.hpp"
+#include "shader-stats.hpp"
+
+class ShaderCache;
+class ShaderDefines;
+class ShaderSource;
+class ThreadPool;
+
+namespace ShaderLexer {
+    class TokenStream;
+};
+
+// All arrays referenced by the layouts live in the ShaderInfo's arena and are released
+// together with it. Names are symbols of a StringInterner that may be shared between many
+// ShaderInfos, except for the member paths of flattened bodies which only the ShaderInfo
+// holds. Use getString() to resolve either.
 class ShaderInfo {
     public:
+        typedef StringInterner::Symbol Symbol;
+
+        // Buffer block members also carry their placement under the block's memory layout,
+        // all in bytes. An unsized array has an arraySize of -1 and a size of 0, an array
+        // sized by a constant the parser does not evaluate an arraySize of 0.
         struct Variable {
-            String typeName;
-            String name;
+            Symbol typeName;
+            Symbol name;
             bool isArray;
             int32 arraySize;
+
+            uint32 offset;
+            uint32 size;
+            uint32 alignment;
+            uint32 arrayStride;  // 0 unless the variable is an array
+            uint32 matrixStride; // 0 unless the variable is a matrix
+        };
+
+        // A top level struct definition. Its members have no placement of their own, that
+        // depends on the memory layout of the block the struct is used in.
+        struct StructType {
+            Symbol name;
+            Memory::ArenaArray<Variable> members;
+        };
+
+        struct Option {
+            Symbol name;
+            int32 value; // TODO: confirm all option values are numeric or nonexistent
         };
 
         enum class LayoutType {
@@ -21,31 +64,156 @@ class ShaderInfo {
             ATTRIB_IN,
             ATTRIB_OUT,
             UNIFORM,
+            // a uniform block with the push_constant option
+            PUSH_CONSTANT,
+            // a shared variable of a compute shader, declared without a layout
+            SHARED,
+            // layout(constant_id = N) const
+            SPECIALIZATION_CONSTANT,
+            // layout(local_size_x = ...) in;, the sizes are among the options
+            WORKGROUP_SIZE,
 
             INVALID
         };
 
+        // what a layout is bound to a pipeline as, NONE for everything that takes no binding
+        enum class DescriptorType {
+            SAMPLER,
+            COMBINED_IMAGE_SAMPLER,
+            SAMPLED_IMAGE,
+            STORAGE_IMAGE,
+            UNIFORM_TEXEL_BUFFER,
+            STORAGE_TEXEL_BUFFER,
+            UNIFORM_BUFFER,
+            STORAGE_BUFFER,
+            INPUT_ATTACHMENT,
+            ACCELERATION_STRUCTURE,
+            // OpenGL only
+            ATOMIC_COUNTER,
+
+            NONE
+        };
+
+        enum class MemoryLayout {
+            STD140,
+            STD430,
+            SCALAR,
+
+            // not a buffer block, or its members could not be laid out
+            NONE
+        };
+
         struct Layout {
             LayoutType type = LayoutType::INVALID;
+            MemoryLayout memoryLayout = MemoryLayout::NONE;
+
+            Memory::ArenaArray<Option> options;
+            Memory::ArenaArray<Symbol> memoryQualifiers;
+            Symbol name;
+            Symbol typeQualifier;
+
+            DescriptorType descriptorType = DescriptorType::NONE;
+            // the format option of an image (rgba32f), empty if it has none
+            Symbol imageFormat;
+            // Arrays of variables and block instances. An unsized array has a size of -1 and
+            // one sized by a constant the parser does not evaluate a size of 0.
+            bool isArray = false;
+            int32 arraySize = 0;
+            // the literal a specialization constant defaults to, as written
+            Symbol defaultValue;
 
-            HashMap<String, int32> options; // TODO: confirm all option values are numeric or nonexistent
-            ArrayList<String> memoryQualifiers;
-            String name;
-            String typeQualifier;
+            Memory::ArenaArray<ShaderInfo::Variable> body;
+            // the body with struct members replaced by their leaf members, which are named by
+            // their path (lights[3].color) and placed relative to the block, empty if the
+            // members could not be laid out. The first element stands in for an unsized array
+            // of structs and for one too large to list every element of.
+            Memory::ArenaArray<ShaderInfo::Variable> flattenedBody;
+            // size of the block without the elements of a trailing unsized array
+            uint32 blockSize = 0;
+            uint32 unsizedArrayStride = 0;
 
-            ArrayList<ShaderInfo::Variable> body;
+            const Option* findOption(Symbol optionName) const;
+        };
+
+        enum class ScanMode {
+            // tokenize the whole source
+            FULL,
+            // tokenize only top level declarations, skipping function bodies unread
+            DECLARATIONS
         };
 
         static const char* stringifyLayoutType(enum LayoutType type);
+        static const char* stringifyMemoryLayout(enum MemoryLayout memoryLayout);
+        static const char* stringifyDescriptorType(enum DescriptorType type);
 
-        ShaderInfo() = default;
+        // Loads and parses every file on the pool, includes are shared through the global
+        // IncludeCache. results[i] belongs to fileNames[i] and is null if that file failed to
+        // load, a file with errors keeps the layouts that parsed.
+        // Files are preprocessed with defines if it is not null, and taken from or added to
+        // cache if it is not null.
+        static bool parseBatch(const ArrayList<String>& fileNames,
+                ArrayList<Memory::UniquePointer<ShaderInfo>>& results, ThreadPool& pool,
+                ScanMode mode = ScanMode::FULL, const ShaderDefines* defines = nullptr,
+                ShaderCache* cache = nullptr);
+
+        explicit ShaderInfo(Memory::SharedPointer<StringInterner> interner
+                = StringInterner::getGlobal(), uintptr arenaBlockSize = 4096);
 
         bool parse(std::istream& shaderData);
+        // shaderData must stay alive for the duration of the call, tokens refer into it
+        bool parse(StringView shaderData, ScanMode mode = ScanMode::FULL);
+        bool parse(const ShaderSource& source, ScanMode mode = ScanMode::FULL);
+        // the same as above with the source run through the preprocessor first, directives
+        // are otherwise ignored
+        bool parse(StringView shaderData, const ShaderDefines& defines,
+                ScanMode mode = ScanMode::FULL);
+        bool parse(const ShaderSource& source, const ShaderDefines& defines,
+                ScanMode mode = ScanMode::FULL);
+        // parses whatever tokens remain in tokens
+        bool parse(ShaderLexer::TokenStream& tokens);
+        // A parse that returns false has still kept the layouts and structs declared outside
+        // of the declarations that failed, which are skipped. Errors are added to the
+        // diagnostics, those of the preprocessor end the parse.
+        const ArrayList<ShaderLexer::Diagnostic>& getDiagnostics() const;
 
         ArrayList<Layout>& getLayoutInfo();
         const ArrayList<Layout>& getLayoutInfo() const;
+
+        ArrayList<StructType>& getStructTypes();
+        const ArrayList<StructType>& getStructTypes() const;
+        const StructType* findStructType(Symbol name) const;
+
+        // Local size of a compute shader, 1 in every dimension no WORKGROUP_SIZE layout sets.
+        // false if there is no such layout. A dimension can still be overridden by the
+        // specialization constant a local_size_x_id option names.
+        bool getWorkgroupSize(uint32 (&size)[3]) const;
+
+        // arrays of layouts and struct types added from outside must be allocated here
+        Memory::Arena& getArena();
+
+        StringInterner& getInterner() const;
+        StringView getString(Symbol symbol) const;
+        // symbol of a path in a flattened body, kept out of the interner so the paths of one
+        // large block don't stay in a shared interner for good
+        Symbol internPath(StringView path);
+
+        // summed over every parse of this ShaderInfo, and the load when parseBatch() did it
+        ShaderStats& getStats();
+        const ShaderStats& getStats() const;
     private:
         NULL_COPY_AND_ASSIGN(ShaderInfo);
 
+        // set in the symbols internPath() hands out
+        static constexpr Symbol PATH_SYMBOL_BIT = 0x80000000u;
+
+        Memory::SharedPointer<StringInterner> interner;
+        HashMap<StringView, Symbol> pathSymbols;
+        ArrayList<StringView> paths;
+
+        Memory::Arena arena;
         ArrayList<Layout> layoutInfo;
+        ArrayList<StructType> structTypes;
+        ArrayList<ShaderLexer::Diagnostic> diagnostics;
+
+        ShaderStats stats;
 };
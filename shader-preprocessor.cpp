@@ -0,0 +1,898 @@
+#include "shader-preprocessor.hpp"
+
+#include "shader-token-stream.hpp"
+
+#include <engine/core/trace.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace {
+    using Token = ShaderLexer::Token;
+
+    constexpr const char* COMMAND_LINE_FILE_NAME = "<command line>";
+
+    enum Operator {
+        OP_NONE,
+        OP_LOGICAL_OR,
+        OP_LOGICAL_AND,
+        OP_OR,
+        OP_XOR,
+        OP_AND,
+        OP_EQUAL,
+        OP_NOT_EQUAL,
+        OP_LESS,
+        OP_GREATER,
+        OP_LESS_EQUAL,
+        OP_GREATER_EQUAL,
+        OP_SHIFT_LEFT,
+        OP_SHIFT_RIGHT,
+        OP_ADD,
+        OP_SUBTRACT,
+        OP_MULTIPLY,
+        OP_DIVIDE,
+        OP_MODULO
+    };
+
+    // #if expressions: integer arithmetic with the operators and precedence of C
+    class ExpressionEvaluator {
+        public:
+            ExpressionEvaluator(const Token* begin, const Token* end);
+
+            bool evaluate(int64& value);
+
+            inline const char* getError() const { return errorMessage; }
+        private:
+            bool parseConditional(int64& value);
+            bool parseBinary(int32 minPrecedence, int64& value);
+            bool parseUnary(int64& value);
+
+            // binary operator at the current token, length is the number of tokens it spans
+            Operator peekOperator(uint32& length, int32& precedence) const;
+
+            bool fail(const char* message);
+
+            const Token* c;
+            const Token* end;
+
+            const char* errorMessage = nullptr;
+    };
+
+    // the character of a one character punctuation token, 0 for anything else
+    char getPunctuator(const Token& token);
+    bool isWord(const Token& token);
+    // operators are lexed one character at a time, == is two tokens right next to each other
+    bool isAdjacent(const Token& first, const Token& second);
+
+    bool parseNumber(StringView text, int64& value);
+};
+
+void ShaderDefines::define(const String& name, const String& value) {
+    defines[name] = value;
+}
+
+void ShaderDefines::undefine(const String& name) {
+    defines.erase(name);
+}
+
+void ShaderDefines::parseDefinition(StringView definition) {
+    size_t separator = definition.find('=');
+
+    if (separator == StringView::npos) {
+        define(String(definition.data(), definition.size()));
+    }
+    else {
+        define(String(definition.data(), separator), String(definition.data() + separator + 1,
+                definition.size() - separator - 1));
+    }
+}
+
+ShaderPreprocessor::ShaderPreprocessor(const ShaderDefines& defines) {
+    for (const auto& define : defines.getDefines()) {
+        Macro& macro = macros[StringView(define.first)];
+        macro.functionLike = false;
+
+        ShaderLexer::tokenizeShaderSource(define.second, ::COMMAND_LINE_FILE_NAME, 1, macro.body);
+    }
+}
+
+bool ShaderPreprocessor::next(ShaderLexer::TokenStream& input, Token& token) {
+    stream = &input;
+
+    while (!error) {
+        if (expansionIndex < expansion.size()) {
+            token = expansion[expansionIndex++];
+        }
+        else {
+            const Token* raw = peekRaw(input);
+
+            if (raw == nullptr) {
+                if (!conditionals.empty()) {
+                    Token location = {Token::TYPE_INVALID, conditionals.back().line, StringView(),
+                            conditionals.back().fileName};
+                    input.report(&location, "Unterminated conditional directive");
+                    error = true;
+                }
+
+                return false;
+            }
+
+            bool lineStart = raw->line != previousLine || raw->fileName != previousFileName;
+
+            token = *raw;
+            consumeRaw();
+
+            if (token.type == Token::TYPE_POUND_SIGN && lineStart) {
+                Trace::Scope scope("Preprocess", token.fileName);
+                readDirective(input, token);
+
+                if (!handleDirective(token)) {
+                    error = true;
+                }
+
+                continue;
+            }
+
+            if (isSkipping()) {
+                continue;
+            }
+
+            const Macro* macro = ::isWord(token) ? findMacro(token.data) : nullptr;
+
+            if (macro != nullptr) {
+                invocation.clear();
+                invocation.push_back(token);
+
+                if (macro->functionLike) {
+                    const Token* paren = peekRaw(input);
+
+                    // a function like macro name without arguments is left alone
+                    if (paren == nullptr || paren->type != Token::TYPE_OPEN_PAREN) {
+                        macro = nullptr;
+                    }
+                    else {
+                        uint32 depth = 0;
+
+                        do {
+                            const Token* argument = peekRaw(input);
+
+                            if (argument == nullptr) {
+                                input.report(&token, "Unterminated invocation of macro %.*s",
+                                        (int)token.data.size(), token.data.data());
+                                error = true;
+
+                                return false;
+                            }
+
+                            if (argument->type == Token::TYPE_OPEN_PAREN) {
+                                ++depth;
+                            }
+                            else if (argument->type == Token::TYPE_CLOSE_PAREN) {
+                                --depth;
+                            }
+
+                            invocation.push_back(*argument);
+                            consumeRaw();
+                        }
+                        while (depth > 0);
+                    }
+                }
+
+                if (macro != nullptr) {
+                    expansion.clear();
+                    expansionIndex = 0;
+
+                    if (!expand(invocation.data(), invocation.data() + invocation.size(), token,
+                            expansion)) {
+                        error = true;
+                    }
+
+                    continue;
+                }
+            }
+        }
+
+        if (lineOffset != 0 && token.fileName == lineFileName) {
+            token.line = (uint32)((int32)token.line + lineOffset);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+const ShaderLexer::Token* ShaderPreprocessor::peekRaw(ShaderLexer::TokenStream& input) {
+    if (!hasPending) {
+        if (!input.produceRaw(pending)) {
+            return nullptr;
+        }
+
+        hasPending = true;
+    }
+
+    return &pending;
+}
+
+void ShaderPreprocessor::consumeRaw() {
+    previousLine = pending.line;
+    previousFileName = pending.fileName;
+
+    hasPending = false;
+}
+
+void ShaderPreprocessor::readDirective(ShaderLexer::TokenStream& input, const Token& pound) {
+    directive.clear();
+
+    uint32 line = pound.line;
+
+    while (const Token* token = peekRaw(input)) {
+        if (token->line != line || token->fileName != pound.fileName) {
+            break;
+        }
+
+        // a backslash continues the directive on the next line
+        if (::getPunctuator(*token) == '\\') {
+            ++line;
+        }
+        else {
+            directive.push_back(*token);
+        }
+
+        consumeRaw();
+    }
+}
+
+bool ShaderPreprocessor::handleDirective(const Token& pound) {
+    // the null directive, a lone #
+    if (directive.empty()) {
+        return true;
+    }
+
+    const Token& name = directive[0];
+    const Token* begin = directive.data() + 1;
+    const Token* end = directive.data() + directive.size();
+
+    if (name.data == "if" || name.data == "ifdef" || name.data == "ifndef") {
+        bool parentActive = !isSkipping();
+        bool result = false;
+
+        // conditions of a skipped group are never looked at, they may not even be valid
+        if (parentActive) {
+            if (name.data == "if") {
+                if (!evaluate(begin, end, name, result)) {
+                    return false;
+                }
+            }
+            else if (begin == end || !::isWord(*begin)) {
+                stream->report(&name, "Expected a macro name after #%.*s", (int)name.data.size(),
+                        name.data.data());
+                return false;
+            }
+            else {
+                result = (findMacro(begin->data) != nullptr) == (name.data == "ifdef");
+            }
+        }
+
+        conditionals.push_back({parentActive && result, result, parentActive, false, name.line,
+                name.fileName});
+
+        return true;
+    }
+
+    if (name.data == "elif" || name.data == "else" || name.data == "endif") {
+        if (conditionals.empty()) {
+            stream->report(&name, "#%.*s without #if", (int)name.data.size(), name.data.data());
+            return false;
+        }
+
+        Conditional& conditional = conditionals.back();
+
+        if (name.data == "endif") {
+            conditionals.pop_back();
+            return true;
+        }
+
+        if (conditional.seenElse) {
+            stream->report(&name, "#%.*s after #else", (int)name.data.size(), name.data.data());
+            return false;
+        }
+
+        bool result = true;
+
+        if (!conditional.parentActive || conditional.taken) {
+            result = false;
+        }
+        else if (name.data == "elif" && !evaluate(begin, end, name, result)) {
+            return false;
+        }
+
+        conditional.active = result;
+        conditional.taken = conditional.taken || result;
+        conditional.seenElse = name.data == "else";
+
+        return true;
+    }
+
+    if (isSkipping()) {
+        return true;
+    }
+
+    if (name.data == "define") {
+        return define(begin, end, name);
+    }
+
+    if (name.data == "undef") {
+        if (begin == end || !::isWord(*begin)) {
+            stream->report(&name, "Expected a macro name after #undef");
+            return false;
+        }
+
+        macros.erase(begin->data);
+
+        return true;
+    }
+
+    if (name.data == "line") {
+        ArrayList<Token> expanded;
+        int64 line;
+
+        if (!expand(begin, end, name, expanded) || expanded.empty()
+                || expanded[0].type != Token::TYPE_NUMERIC || !::parseNumber(expanded[0].data, line)) {
+            stream->report(&name, "Expected a line number after #line");
+            return false;
+        }
+
+        // the line after the directive gets the given number, a source string number is ignored
+        lineOffset = (int32)(line - (int64)pound.line - 1);
+        lineFileName = pound.fileName;
+
+        return true;
+    }
+
+    if (name.data == "error") {
+        StringView message;
+
+        if (begin != end) {
+            message = StringView(begin->data.data(), end[-1].data.data() + end[-1].data.size()
+                    - begin->data.data());
+        }
+
+        stream->report(&name, "#error %.*s", (int)message.size(), message.data());
+
+        return false;
+    }
+
+    // #version, #extension, #pragma and includes left over when parsing a plain string
+    return true;
+}
+
+bool ShaderPreprocessor::define(const Token* begin, const Token* end, const Token& directive) {
+    if (begin == end || !::isWord(*begin)) {
+        stream->report(&directive, "Expected a macro name after #define");
+        return false;
+    }
+
+    const Token& name = *begin++;
+
+    Macro macro;
+    macro.functionLike = false;
+
+    // only a parenthesis right after the name starts a parameter list
+    if (begin != end && begin->type == Token::TYPE_OPEN_PAREN && ::isAdjacent(name, *begin)) {
+        macro.functionLike = true;
+
+        if (++begin != end && begin->type == Token::TYPE_CLOSE_PAREN) {
+            ++begin;
+        }
+        else {
+            for (;;) {
+                if (begin == end || !::isWord(*begin)) {
+                    stream->report(&directive, "Expected a macro parameter name");
+                    return false;
+                }
+
+                macro.parameters.push_back(begin->data);
+                ++begin;
+
+                if (begin != end && begin->type == Token::TYPE_COMMA) {
+                    ++begin;
+                }
+                else if (begin != end && begin->type == Token::TYPE_CLOSE_PAREN) {
+                    ++begin;
+                    break;
+                }
+                else {
+                    stream->report(&directive, "Expected , or ) after a macro parameter");
+                    return false;
+                }
+            }
+        }
+    }
+
+    macro.body.assign(begin, end);
+    macros[name.data] = std::move(macro);
+
+    return true;
+}
+
+bool ShaderPreprocessor::evaluate(const Token* begin, const Token* end, const Token& directive,
+        bool& result) {
+    ArrayList<Token> expression;
+
+    // defined is resolved before expansion so that the names it tests stay unexpanded
+    for (const Token* c = begin; c != end; ++c) {
+        if (c->data != "defined") {
+            expression.push_back(*c);
+            continue;
+        }
+
+        bool paren = ++c != end && c->type == Token::TYPE_OPEN_PAREN;
+
+        if (paren) {
+            ++c;
+        }
+
+        if (c == end || !::isWord(*c)) {
+            stream->report(&directive, "Expected a macro name after defined");
+            return false;
+        }
+
+        bool isDefined = findMacro(c->data) != nullptr;
+
+        if (paren && (++c == end || c->type != Token::TYPE_CLOSE_PAREN)) {
+            stream->report(&directive, "Expected ) after defined");
+            return false;
+        }
+
+        expression.push_back({Token::TYPE_NUMERIC, directive.line, isDefined ? "1" : "0",
+                directive.fileName});
+    }
+
+    ArrayList<Token> expanded;
+
+    if (!expand(expression.data(), expression.data() + expression.size(), directive, expanded)) {
+        return false;
+    }
+
+    ::ExpressionEvaluator evaluator(expanded.data(), expanded.data() + expanded.size());
+    int64 value;
+
+    if (!evaluator.evaluate(value)) {
+        stream->report(&directive, "Invalid #%.*s expression: %s", (int)directive.data.size(),
+                directive.data.data(), evaluator.getError());
+        return false;
+    }
+
+    result = value != 0;
+
+    return true;
+}
+
+bool ShaderPreprocessor::expand(const Token* begin, const Token* end, const Token& origin,
+        ArrayList<Token>& output) {
+    while (begin != end) {
+        const Token& token = *begin++;
+        const Macro* macro = ::isWord(token) ? findMacro(token.data) : nullptr;
+
+        if (macro == nullptr || std::find(disabledMacros.begin(), disabledMacros.end(), token.data)
+                != disabledMacros.end()) {
+            output.push_back(token);
+            continue;
+        }
+
+        SmallArrayList<Pair<const Token*, const Token*>, 8> arguments;
+
+        if (macro->functionLike) {
+            if (begin == end || begin->type != Token::TYPE_OPEN_PAREN) {
+                output.push_back(token);
+                continue;
+            }
+
+            const Token* argumentStart = ++begin;
+            uint32 depth = 1;
+
+            for (; begin != end; ++begin) {
+                if (begin->type == Token::TYPE_OPEN_PAREN) {
+                    ++depth;
+                }
+                else if (begin->type == Token::TYPE_CLOSE_PAREN && --depth == 0) {
+                    break;
+                }
+                else if (begin->type == Token::TYPE_COMMA && depth == 1) {
+                    arguments.emplace_back(argumentStart, begin);
+                    argumentStart = begin + 1;
+                }
+            }
+
+            if (begin == end) {
+                stream->report(&origin, "Unterminated invocation of macro %.*s",
+                        (int)token.data.size(), token.data.data());
+                return false;
+            }
+
+            arguments.emplace_back(argumentStart, begin);
+            ++begin;
+
+            // F() passes no arguments rather than a single empty one
+            if (macro->parameters.empty() && arguments[0].first == arguments[0].second) {
+                arguments.clear();
+            }
+
+            if (arguments.size() != macro->parameters.size()) {
+                stream->report(&origin, "Macro %.*s expects %u arguments, got %u",
+                        (int)token.data.size(), token.data.data(),
+                        (uint32)macro->parameters.size(), (uint32)arguments.size());
+                return false;
+            }
+        }
+
+        ArrayList<Token> substituted;
+
+        for (const auto& bodyToken : macro->body) {
+            auto parameter = std::find(macro->parameters.begin(), macro->parameters.end(),
+                    bodyToken.data);
+
+            // arguments are fully expanded before they are substituted
+            if (parameter != macro->parameters.end() && ::isWord(bodyToken)) {
+                const auto& argument = arguments[parameter - macro->parameters.begin()];
+
+                if (!expand(argument.first, argument.second, origin, substituted)) {
+                    return false;
+                }
+            }
+            else {
+                substituted.push_back({bodyToken.type, origin.line, bodyToken.data, origin.fileName});
+            }
+        }
+
+        disabledMacros.push_back(token.data);
+        bool expanded = expand(substituted.data(), substituted.data() + substituted.size(), origin,
+                output);
+        disabledMacros.pop_back();
+
+        if (!expanded) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const ShaderPreprocessor::Macro* ShaderPreprocessor::findMacro(StringView name) const {
+    if (macros.empty()) {
+        return nullptr;
+    }
+
+    auto it = macros.find(name);
+
+    return it != macros.end() ? &it->second : nullptr;
+}
+
+bool ShaderPreprocessor::isSkipping() const {
+    return !conditionals.empty() && !conditionals.back().active;
+}
+
+namespace {
+    ExpressionEvaluator::ExpressionEvaluator(const Token* begin, const Token* end)
+            : c(begin)
+            , end(end) {}
+
+    bool ExpressionEvaluator::evaluate(int64& value) {
+        if (!parseConditional(value)) {
+            return false;
+        }
+
+        if (c != end) {
+            return fail("unexpected token after the expression");
+        }
+
+        return true;
+    }
+
+    bool ExpressionEvaluator::parseConditional(int64& value) {
+        if (!parseBinary(1, value)) {
+            return false;
+        }
+
+        if (c == end || ::getPunctuator(*c) != '?') {
+            return true;
+        }
+
+        ++c;
+        int64 ifTrue, ifFalse;
+
+        if (!parseConditional(ifTrue)) {
+            return false;
+        }
+
+        if (c == end || ::getPunctuator(*c) != ':') {
+            return fail("expected :");
+        }
+
+        ++c;
+
+        if (!parseConditional(ifFalse)) {
+            return false;
+        }
+
+        value = value != 0 ? ifTrue : ifFalse;
+
+        return true;
+    }
+
+    bool ExpressionEvaluator::parseBinary(int32 minPrecedence, int64& value) {
+        if (!parseUnary(value)) {
+            return false;
+        }
+
+        for (;;) {
+            uint32 length;
+            int32 precedence;
+            Operator op = peekOperator(length, precedence);
+
+            if (op == OP_NONE || precedence < minPrecedence) {
+                return true;
+            }
+
+            c += length;
+            int64 rhs;
+
+            if (!parseBinary(precedence + 1, rhs)) {
+                return false;
+            }
+
+            switch (op) {
+                case OP_LOGICAL_OR:
+                    value = value != 0 || rhs != 0;
+                    break;
+                case OP_LOGICAL_AND:
+                    value = value != 0 && rhs != 0;
+                    break;
+                case OP_OR:
+                    value |= rhs;
+                    break;
+                case OP_XOR:
+                    value ^= rhs;
+                    break;
+                case OP_AND:
+                    value &= rhs;
+                    break;
+                case OP_EQUAL:
+                    value = value == rhs;
+                    break;
+                case OP_NOT_EQUAL:
+                    value = value != rhs;
+                    break;
+                case OP_LESS:
+                    value = value < rhs;
+                    break;
+                case OP_GREATER:
+                    value = value > rhs;
+                    break;
+                case OP_LESS_EQUAL:
+                    value = value <= rhs;
+                    break;
+                case OP_GREATER_EQUAL:
+                    value = value >= rhs;
+                    break;
+                case OP_SHIFT_LEFT:
+                    value = (int64)((uint64)value << (rhs & 63));
+                    break;
+                case OP_SHIFT_RIGHT:
+                    value >>= rhs & 63;
+                    break;
+                case OP_ADD:
+                    value = (int64)((uint64)value + (uint64)rhs);
+                    break;
+                case OP_SUBTRACT:
+                    value = (int64)((uint64)value - (uint64)rhs);
+                    break;
+                case OP_MULTIPLY:
+                    value = (int64)((uint64)value * (uint64)rhs);
+                    break;
+                case OP_DIVIDE:
+                case OP_MODULO:
+                    if (rhs == 0) {
+                        return fail("division by zero");
+                    }
+
+                    // the one quotient that overflows wraps like the other operators, rather than trap
+                    if (rhs == -1) {
+                        value = op == OP_DIVIDE ? (int64)(0 - (uint64)value) : 0;
+                    }
+                    else {
+                        value = op == OP_DIVIDE ? value / rhs : value % rhs;
+                    }
+
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    bool ExpressionEvaluator::parseUnary(int64& value) {
+        if (c == end) {
+            return fail("unexpected end of the expression");
+        }
+
+        const Token& token = *c++;
+
+        switch (::getPunctuator(token)) {
+            case '(':
+                if (!parseConditional(value)) {
+                    return false;
+                }
+
+                if (c == end || c->type != Token::TYPE_CLOSE_PAREN) {
+                    return fail("expected )");
+                }
+
+                ++c;
+
+                return true;
+            case '+':
+                return parseUnary(value);
+            case '-':
+                if (!parseUnary(value)) {
+                    return false;
+                }
+
+                value = (int64)(0 - (uint64)value);
+
+                return true;
+            case '~':
+                if (!parseUnary(value)) {
+                    return false;
+                }
+
+                value = ~value;
+
+                return true;
+            case '!':
+                if (!parseUnary(value)) {
+                    return false;
+                }
+
+                value = value == 0;
+
+                return true;
+        }
+
+        if (token.type == Token::TYPE_NUMERIC) {
+            return ::parseNumber(token.data, value) || fail("invalid integer literal");
+        }
+
+        // identifiers left over after expansion are undefined macros
+        if (::isWord(token)) {
+            value = 0;
+            return true;
+        }
+
+        return fail("unexpected token");
+    }
+
+    Operator ExpressionEvaluator::peekOperator(uint32& length, int32& precedence) const {
+        if (c == end) {
+            return OP_NONE;
+        }
+
+        char first = ::getPunctuator(*c);
+        char second = c + 1 != end && ::isAdjacent(*c, c[1]) ? ::getPunctuator(c[1]) : 0;
+
+        length = 2;
+
+        switch (first) {
+            case '|':
+                if (second == '|') {
+                    precedence = 1;
+                    return OP_LOGICAL_OR;
+                }
+
+                length = 1;
+                precedence = 3;
+
+                return OP_OR;
+            case '&':
+                if (second == '&') {
+                    precedence = 2;
+                    return OP_LOGICAL_AND;
+                }
+
+                length = 1;
+                precedence = 5;
+
+                return OP_AND;
+            case '^':
+                length = 1;
+                precedence = 4;
+
+                return OP_XOR;
+            case '=':
+                precedence = 6;
+                return second == '=' ? OP_EQUAL : OP_NONE;
+            case '!':
+                precedence = 6;
+                return second == '=' ? OP_NOT_EQUAL : OP_NONE;
+            case '<':
+            case '>':
+                if (second == first) {
+                    precedence = 8;
+                    return first == '<' ? OP_SHIFT_LEFT : OP_SHIFT_RIGHT;
+                }
+
+                precedence = 7;
+
+                if (second == '=') {
+                    return first == '<' ? OP_LESS_EQUAL : OP_GREATER_EQUAL;
+                }
+
+                length = 1;
+
+                return first == '<' ? OP_LESS : OP_GREATER;
+            case '+':
+            case '-':
+                length = 1;
+                precedence = 9;
+
+                return first == '+' ? OP_ADD : OP_SUBTRACT;
+            case '*':
+            case '/':
+            case '%':
+                length = 1;
+                precedence = 10;
+
+                return first == '*' ? OP_MULTIPLY : first == '/' ? OP_DIVIDE : OP_MODULO;
+            default:
+                return OP_NONE;
+        }
+    }
+
+    bool ExpressionEvaluator::fail(const char* message) {
+        errorMessage = message;
+        return false;
+    }
+
+    char getPunctuator(const Token& token) {
+        if (token.data.size() != 1 || token.type == Token::TYPE_IDENTIFIER
+                || token.type == Token::TYPE_NUMERIC) {
+            return 0;
+        }
+
+        return token.data[0];
+    }
+
+    bool isWord(const Token& token) {
+        return !token.data.empty() && (std::isalpha((unsigned char)token.data[0])
+                || token.data[0] == '_');
+    }
+
+    bool isAdjacent(const Token& first, const Token& second) {
+        return second.data.data() == first.data.data() + first.data.size();
+    }
+
+    bool parseNumber(StringView text, int64& value) {
+        if (!text.empty() && (text.back() == 'u' || text.back() == 'U')) {
+            text.remove_suffix(1);
+        }
+
+        const char* first = text.data();
+        const char* last = first + text.size();
+        int base = 10;
+
+        if (text.size() > 2 && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) {
+            first += 2;
+            base = 16;
+        }
+        else if (text.size() > 1 && first[0] == '0') {
+            ++first;
+            base = 8;
+        }
+
+        auto result = std::from_chars(first, last, value, base);
+
+        return result.ec == std::errc() && result.ptr == last;
+    }
+};
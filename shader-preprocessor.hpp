@@ -0,0 +1,106 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/hash-map.hpp>
+
+#include "shader-lexer.hpp"
+
+namespace ShaderLexer {
+    class TokenStream;
+};
+
+// Macros a shader is preprocessed with, the equivalent of a compiler's -D options
+class ShaderDefines {
+    public:
+        // value is the replacement text of the macro
+        void define(const String& name, const String& value = "1");
+        void undefine(const String& name);
+
+        // NAME or NAME=VALUE
+        void parseDefinition(StringView definition);
+
+        inline const HashMap<String, String>& getDefines() const { return defines; }
+    private:
+        HashMap<String, String> defines;
+};
+
+// GLSL preprocessor working on the tokens of a TokenStream. It handles object and function
+// like macros, #undef, the conditional directives with defined(), #line and #error. Other
+// directives (#version, #extension, #pragma and #include, which ShaderSource has already
+// resolved) are dropped. Tokens of expanded macros report the location of their invocation.
+class ShaderPreprocessor {
+    public:
+        // defines must outlive the preprocessor, macro bodies refer into it
+        explicit ShaderPreprocessor(const ShaderDefines& defines);
+
+        // next token of input after preprocessing, false at the end of input or on an error
+        bool next(ShaderLexer::TokenStream& input, ShaderLexer::Token& token);
+
+        inline bool hasError() const { return error; }
+    private:
+        NULL_COPY_AND_ASSIGN(ShaderPreprocessor);
+
+        typedef ShaderLexer::Token Token;
+
+        struct Macro {
+            bool functionLike;
+            SmallArrayList<StringView, 4> parameters;
+            ArrayList<Token> body;
+        };
+
+        struct Conditional {
+            bool active;   // tokens of the current group are kept
+            bool taken;    // a group of this conditional has been kept already
+            bool parentActive;
+            bool seenElse;
+            uint32 line;
+            const char* fileName;
+        };
+
+        const Token* peekRaw(ShaderLexer::TokenStream& input);
+        void consumeRaw();
+
+        void readDirective(ShaderLexer::TokenStream& input, const Token& pound);
+        bool handleDirective(const Token& pound);
+
+        bool define(const Token* begin, const Token* end, const Token& directive);
+        bool evaluate(const Token* begin, const Token* end, const Token& directive, bool& result);
+
+        // expands the macros in [begin, end), tokens taken from macro bodies are moved to
+        // the location of origin
+        bool expand(const Token* begin, const Token* end, const Token& origin,
+                ArrayList<Token>& output);
+
+        const Macro* findMacro(StringView name) const;
+        bool isSkipping() const;
+
+        HashMap<StringView, Macro> macros;
+        SmallArrayList<Conditional, 8> conditionals;
+        // macros being expanded, which must not expand themselves again
+        SmallArrayList<StringView, 8> disabledMacros;
+
+        Token pending;
+        bool hasPending = false;
+
+        uint32 previousLine = 0;
+        const char* previousFileName = nullptr;
+
+        // tokens of the directive being handled, the # excluded
+        ArrayList<Token> directive;
+        ArrayList<Token> invocation;
+
+        ArrayList<Token> expansion;
+        uint32 expansionIndex = 0;
+
+        // set by #line, added to the lines of lineFileName
+        int32 lineOffset = 0;
+        const char* lineFileName = nullptr;
+
+        // the stream next() is preprocessing, errors are reported to it
+        ShaderLexer::TokenStream* stream = nullptr;
+        bool error = false;
+};
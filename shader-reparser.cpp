@@ -0,0 +1,452 @@
+#include "shader-reparser.hpp"
+
+#include "shader-lexer.hpp"
+#include "shader-token-stream.hpp"
+
+#include <algorithm>
+
+namespace {
+    using Symbol = ShaderInfo::Symbol;
+
+    struct EditMap {
+        const ArrayList<ShaderReparser::Edit>& edits;
+
+        // true if [begin, end) of the new source touches an edit
+        bool overlaps(uint32 begin, uint32 end) const;
+        // position in the previous source of a position of the new source outside every edit
+        uint32 toPrevious(uint32 position) const;
+    };
+
+    void copyResults(const ShaderInfo& from, uint32 firstLayout, uint32 layoutCount,
+            uint32 firstStruct, uint32 structCount, ShaderInfo& to);
+
+    void diffLayouts(const ShaderInfo& previous, const ShaderInfo& current, ShaderDiff& diff);
+    // false if the layouts differ in anything but their members
+    bool equalQualifiers(const ShaderInfo::Layout& a, const ShaderInfo::Layout& b);
+    void diffVariables(const ShaderInfo& previousInfo, const ShaderInfo::Layout& previous,
+            const ShaderInfo& currentInfo, const ShaderInfo::Layout& current,
+            ArrayList<ShaderDiff::VariableChange>& changes);
+    bool equalVariables(const ShaderInfo::Variable& a, const ShaderInfo::Variable& b);
+
+    uint32 countLines(StringView text);
+};
+
+ShaderReparser::ShaderReparser(Memory::SharedPointer<StringInterner> interner)
+        : interner(interner)
+        , shaderInfo(Memory::make_unique<ShaderInfo>(interner))
+        , previousShaderInfo(Memory::make_unique<ShaderInfo>(interner)) {}
+
+bool ShaderReparser::parse(StringView source, ShaderDiff* diff) {
+    ShaderLexer::DeclarationScanner scanner;
+    scanner.setSource(source, 1);
+
+    ArrayList<Declaration> newDeclarations;
+    StringView region;
+    uint32 line;
+
+    while (scanner.nextRegion(region, line)) {
+        addDeclaration(source, region, line, newDeclarations);
+    }
+
+    scannedSize = (uint32)source.size();
+
+    return build(source, newDeclarations, 0, false, diff);
+}
+
+bool ShaderReparser::reparse(StringView source, const ArrayList<Edit>& edits, ShaderDiff& diff) {
+    if (!valid) {
+        return parse(source, &diff);
+    }
+
+    diff.layouts.clear();
+
+    if (edits.empty()) {
+        parsedCount = 0;
+        scannedSize = 0;
+
+        return true;
+    }
+
+    int64 sizeDelta = 0;
+    int64 lineDelta = 0;
+
+    for (const auto& edit : edits) {
+        StringView removed = StringView(this->source).substr(edit.offset, edit.removedLength);
+        StringView inserted = source.substr(edit.offset + sizeDelta, edit.insertedLength);
+
+        lineDelta += (int64)::countLines(inserted) - ::countLines(removed);
+        sizeDelta += (int64)edit.insertedLength - edit.removedLength;
+    }
+
+    const Edit& lastEdit = edits.back();
+    uint32 lastEditEnd = (uint32)(lastEdit.offset + sizeDelta + lastEdit.removedLength);
+
+    // Declarations ending before the first edit are untouched, and the scanner is between
+    // statements right after each of them. A # line also ends at an edit right behind it.
+    uint32 kept = (uint32)(std::partition_point(declarations.begin(), declarations.end(),
+            [&](const Declaration& declaration) {
+        return declaration.end < edits.front().offset;
+    }) - declarations.begin());
+
+    uint32 restart = kept > 0 ? declarations[kept - 1].end : 0;
+    uint32 restartLine = kept > 0 ? declarations[kept - 1].endLine : 1;
+
+    ArrayList<Declaration> newDeclarations(declarations.begin(), declarations.begin() + kept);
+
+    for (uint32 i = 0; i < kept; ++i) {
+        newDeclarations[i].previous = i;
+    }
+
+    ShaderLexer::DeclarationScanner scanner;
+    scanner.setSource(source.substr(restart), restartLine);
+
+    ::EditMap editMap = {edits};
+    StringView region;
+    uint32 line;
+    uint32 resynced = NOT_REUSED;
+    uint32 searchFrom = kept;
+
+    scannedSize = (uint32)source.size() - restart;
+
+    while (scanner.nextRegion(region, line)) {
+        addDeclaration(source, region, line, newDeclarations);
+        Declaration& declaration = newDeclarations.back();
+
+        bool edited = editMap.overlaps(declaration.begin, declaration.end);
+
+        if (edited && declaration.end < lastEditEnd) {
+            continue;
+        }
+
+        // a declaration of the previous source ending in the same place of the same text
+        uint32 previousEnd = editMap.toPrevious(declaration.end);
+        auto match = std::lower_bound(declarations.begin() + searchFrom, declarations.end(),
+                previousEnd, [](const Declaration& d, uint32 end) { return d.end < end; });
+
+        if (match == declarations.end() || match->end != previousEnd) {
+            continue;
+        }
+
+        searchFrom = (uint32)(match - declarations.begin());
+
+        if (!edited && match->begin == editMap.toPrevious(declaration.begin)) {
+            declaration.previous = searchFrom;
+        }
+
+        // Past the last edit both scans are between statements at the same text, so every
+        // declaration from here on is found as before
+        if (declaration.end >= lastEditEnd) {
+            resynced = searchFrom;
+            scannedSize = declaration.end - restart;
+            break;
+        }
+    }
+
+    bool structsChanged = false;
+
+    for (uint32 i = kept; i < declarations.size(); ++i) {
+        // declarations in the rescanned stretch that are gone or parsed again
+        if (resynced != NOT_REUSED && i > resynced) {
+            break;
+        }
+
+        bool reused = std::any_of(newDeclarations.begin() + kept, newDeclarations.end(),
+                [&](const Declaration& d) { return d.previous == i; });
+
+        if (!reused && declarations[i].structCount > 0) {
+            structsChanged = true;
+        }
+    }
+
+    if (resynced != NOT_REUSED) {
+        for (uint32 i = resynced + 1; i < declarations.size(); ++i) {
+            Declaration declaration = declarations[i];
+            declaration.begin = (uint32)(declaration.begin + sizeDelta);
+            declaration.end = (uint32)(declaration.end + sizeDelta);
+            declaration.line = (uint32)(declaration.line + lineDelta);
+            declaration.endLine = (uint32)(declaration.endLine + lineDelta);
+            declaration.previous = i;
+
+            newDeclarations.push_back(declaration);
+        }
+    }
+
+    return build(source, newDeclarations, kept, structsChanged, &diff);
+}
+
+void ShaderReparser::addDeclaration(StringView source, StringView region, uint32 line,
+        ArrayList<Declaration>& declarations) {
+    Declaration declaration = {};
+    declaration.begin = (uint32)(region.data() - source.data());
+    declaration.end = declaration.begin + (uint32)region.size();
+    declaration.line = line;
+    declaration.endLine = line + ::countLines(region);
+    declaration.previous = NOT_REUSED;
+
+    declarations.push_back(declaration);
+}
+
+bool ShaderReparser::build(StringView source, ArrayList<Declaration>& newDeclarations,
+        uint32 firstChanged, bool structsChanged, ShaderDiff* diff) {
+    auto newShaderInfo = Memory::make_unique<ShaderInfo>(interner);
+    bool structsDirty = false;
+
+    parsedCount = 0;
+
+    for (uint32 i = 0; i < newDeclarations.size(); ++i) {
+        Declaration& declaration = newDeclarations[i];
+
+        if (i == firstChanged) {
+            structsDirty = structsChanged;
+        }
+
+        if (declaration.previous != NOT_REUSED) {
+            const Declaration& previous = declarations[declaration.previous];
+
+            // a struct defined twice now is left for the parser to report
+            bool redefined = false;
+
+            for (uint32 j = 0; j < previous.structCount; ++j) {
+                redefined |= newShaderInfo->findStructType(
+                        shaderInfo->getStructTypes()[previous.firstStruct + j].name) != nullptr;
+            }
+
+            // blocks are laid out with the structs of their time
+            if ((!structsDirty || previous.layoutCount == 0) && !redefined) {
+                declaration.firstLayout = (uint32)newShaderInfo->getLayoutInfo().size();
+                declaration.layoutCount = previous.layoutCount;
+                declaration.firstStruct = (uint32)newShaderInfo->getStructTypes().size();
+                declaration.structCount = previous.structCount;
+
+                ::copyResults(*shaderInfo, previous.firstLayout, previous.layoutCount,
+                        previous.firstStruct, previous.structCount, *newShaderInfo);
+
+                continue;
+            }
+        }
+
+        declaration.firstLayout = (uint32)newShaderInfo->getLayoutInfo().size();
+        declaration.firstStruct = (uint32)newShaderInfo->getStructTypes().size();
+
+        ShaderLexer::TokenStream tokens(source.substr(declaration.begin,
+                declaration.end - declaration.begin), "<source>", false, declaration.line);
+
+        uint32 firstDiagnostic = (uint32)newShaderInfo->getDiagnostics().size();
+        bool parsed = newShaderInfo->parse(tokens);
+
+        // the warnings of declarations that parsed are logged along the way
+        for (uint32 j = firstDiagnostic; j < newShaderInfo->getDiagnostics().size(); ++j) {
+            ShaderLexer::logDiagnostic(newShaderInfo->getDiagnostics()[j]);
+        }
+
+        if (!parsed) {
+            // the next call can't rely on the declarations of this source
+            this->source.assign(source.data(), source.size());
+            valid = false;
+
+            return false;
+        }
+
+        ++parsedCount;
+
+        declaration.layoutCount = (uint32)newShaderInfo->getLayoutInfo().size()
+                - declaration.firstLayout;
+        declaration.structCount = (uint32)newShaderInfo->getStructTypes().size()
+                - declaration.firstStruct;
+
+        if (declaration.structCount > 0) {
+            structsDirty = true;
+        }
+    }
+
+    if (diff != nullptr) {
+        diff->layouts.clear();
+        ::diffLayouts(*shaderInfo, *newShaderInfo, *diff);
+    }
+
+    previousShaderInfo = std::move(shaderInfo);
+    shaderInfo = std::move(newShaderInfo);
+    declarations = std::move(newDeclarations);
+    this->source.assign(source.data(), source.size());
+    valid = true;
+
+    return true;
+}
+
+namespace {
+    bool EditMap::overlaps(uint32 begin, uint32 end) const {
+        int64 delta = 0;
+
+        for (const auto& edit : edits) {
+            int64 editBegin = edit.offset + delta;
+            int64 editEnd = editBegin + edit.insertedLength;
+
+            // a pure removal touches the declarations it falls strictly inside of
+            if (editBegin < end && editEnd > begin) {
+                return true;
+            }
+
+            delta += (int64)edit.insertedLength - edit.removedLength;
+        }
+
+        return false;
+    }
+
+    uint32 EditMap::toPrevious(uint32 position) const {
+        int64 delta = 0;
+
+        for (const auto& edit : edits) {
+            if (edit.offset + delta + edit.insertedLength > position) {
+                break;
+            }
+
+            delta += (int64)edit.insertedLength - edit.removedLength;
+        }
+
+        return (uint32)(position - delta);
+    }
+
+    void copyResults(const ShaderInfo& from, uint32 firstLayout, uint32 layoutCount,
+            uint32 firstStruct, uint32 structCount, ShaderInfo& to) {
+        Memory::Arena& arena = to.getArena();
+
+        for (uint32 i = firstStruct; i < firstStruct + structCount; ++i) {
+            const auto& structType = from.getStructTypes()[i];
+
+            to.getStructTypes().push_back({structType.name,
+                    arena.copyArray(structType.members.data(), structType.members.size())});
+        }
+
+        for (uint32 i = firstLayout; i < firstLayout + layoutCount; ++i) {
+            ShaderInfo::Layout layout = from.getLayoutInfo()[i];
+
+            layout.options = arena.copyArray(layout.options.data(), layout.options.size());
+            layout.memoryQualifiers = arena.copyArray(layout.memoryQualifiers.data(),
+                    layout.memoryQualifiers.size());
+            layout.body = arena.copyArray(layout.body.data(), layout.body.size());
+            layout.flattenedBody = arena.copyArray(layout.flattenedBody.data(),
+                    layout.flattenedBody.size());
+
+            // paths are symbols of the ShaderInfo they were laid out in, plain member names
+            // are shared through the interner
+            for (uint32 j = 0; j < layout.flattenedBody.size(); ++j) {
+                auto& var = layout.flattenedBody[j];
+                StringView name = from.getString(var.name);
+
+                if (name.find('.') != StringView::npos) {
+                    var.name = to.internPath(name);
+                }
+            }
+
+            to.getLayoutInfo().push_back(layout);
+        }
+    }
+
+    void diffLayouts(const ShaderInfo& previous, const ShaderInfo& current, ShaderDiff& diff) {
+        const auto& previousLayouts = previous.getLayoutInfo();
+        const auto& currentLayouts = current.getLayoutInfo();
+        ArrayList<bool> matched(previousLayouts.size(), false);
+
+        for (uint32 i = 0; i < currentLayouts.size(); ++i) {
+            const auto& layout = currentLayouts[i];
+            uint32 match = ShaderDiff::NO_INDEX;
+
+            // layouts are identified by kind and name, repeats of both by their order
+            for (uint32 j = 0; j < previousLayouts.size(); ++j) {
+                if (!matched[j] && previousLayouts[j].type == layout.type
+                        && previousLayouts[j].name == layout.name) {
+                    match = j;
+                    break;
+                }
+            }
+
+            if (match == ShaderDiff::NO_INDEX) {
+                diff.layouts.push_back({ShaderDiff::Change::ADDED, ShaderDiff::NO_INDEX, i, {}});
+                continue;
+            }
+
+            matched[match] = true;
+
+            ShaderDiff::LayoutChange change = {ShaderDiff::Change::MODIFIED, match, i, {}};
+            ::diffVariables(previous, previousLayouts[match], current, layout, change.variables);
+
+            if (!change.variables.empty() || !::equalQualifiers(previousLayouts[match], layout)) {
+                diff.layouts.push_back(std::move(change));
+            }
+        }
+
+        for (uint32 j = 0; j < previousLayouts.size(); ++j) {
+            if (!matched[j]) {
+                diff.layouts.push_back({ShaderDiff::Change::REMOVED, j, ShaderDiff::NO_INDEX, {}});
+            }
+        }
+    }
+
+    bool equalQualifiers(const ShaderInfo::Layout& a, const ShaderInfo::Layout& b) {
+        if (a.memoryLayout != b.memoryLayout || a.typeQualifier != b.typeQualifier
+                || a.blockSize != b.blockSize || a.unsizedArrayStride != b.unsizedArrayStride
+                || a.isArray != b.isArray || a.arraySize != b.arraySize
+                || a.defaultValue != b.defaultValue
+                || a.options.size() != b.options.size()
+                || a.memoryQualifiers.size() != b.memoryQualifiers.size()) {
+            return false;
+        }
+
+        for (uint32 i = 0; i < a.options.size(); ++i) {
+            if (a.options[i].name != b.options[i].name || a.options[i].value != b.options[i].value) {
+                return false;
+            }
+        }
+
+        return std::equal(a.memoryQualifiers.begin(), a.memoryQualifiers.end(),
+                b.memoryQualifiers.begin());
+    }
+
+    void diffVariables(const ShaderInfo& previousInfo, const ShaderInfo::Layout& previous,
+            const ShaderInfo& currentInfo, const ShaderInfo::Layout& current,
+            ArrayList<ShaderDiff::VariableChange>& changes) {
+        // the flattened members carry the changes of the structs used
+        const auto& previousVariables = previous.flattenedBody.empty() ? previous.body
+                : previous.flattenedBody;
+        const auto& currentVariables = current.flattenedBody.empty() ? current.body
+                : current.flattenedBody;
+
+        // paths are compared by their text, each ShaderInfo numbers them on its own
+        for (const auto& var : currentVariables) {
+            StringView name = currentInfo.getString(var.name);
+            auto match = std::find_if(previousVariables.begin(), previousVariables.end(),
+                    [&](const ShaderInfo::Variable& v) {
+                        return previousInfo.getString(v.name) == name;
+                    });
+
+            if (match == previousVariables.end()) {
+                changes.push_back({ShaderDiff::Change::ADDED, var.name});
+            }
+            else if (!::equalVariables(*match, var)) {
+                changes.push_back({ShaderDiff::Change::MODIFIED, var.name});
+            }
+        }
+
+        for (const auto& var : previousVariables) {
+            StringView name = previousInfo.getString(var.name);
+
+            if (std::none_of(currentVariables.begin(), currentVariables.end(),
+                    [&](const ShaderInfo::Variable& v) {
+                        return currentInfo.getString(v.name) == name;
+                    })) {
+                changes.push_back({ShaderDiff::Change::REMOVED, var.name});
+            }
+        }
+    }
+
+    bool equalVariables(const ShaderInfo::Variable& a, const ShaderInfo::Variable& b) {
+        return a.typeName == b.typeName && a.isArray == b.isArray
+                && (!a.isArray || a.arraySize == b.arraySize) && a.offset == b.offset
+                && a.size == b.size && a.alignment == b.alignment
+                && a.arrayStride == b.arrayStride && a.matrixStride == b.matrixStride;
+    }
+
+    uint32 countLines(StringView text) {
+        return (uint32)std::count(text.begin(), text.end(), '\n');
+    }
+};
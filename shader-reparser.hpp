@@ -0,0 +1,122 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/memory.hpp>
+
+#include "shader-parser.hpp"
+
+// What changed between two reflections of a shader, so a renderer only rebuilds the
+// resources of the layouts listed
+struct ShaderDiff {
+    static constexpr uint32 NO_INDEX = ~0u;
+
+    enum class Change {
+        ADDED,
+        REMOVED,
+        MODIFIED
+    };
+
+    struct VariableChange {
+        Change change;
+        // resolved with the previous ShaderInfo for a removed variable and with the current
+        // one otherwise, flattened names are symbols of a single ShaderInfo
+        ShaderInfo::Symbol name;
+    };
+
+    struct LayoutChange {
+        Change change;
+        // into the layouts of the previous and the current ShaderInfo, NO_INDEX on the side
+        // the layout is missing from
+        uint32 oldIndex;
+        uint32 newIndex;
+        // members of a modified block that changed, by their flattened name, empty if only
+        // the layout's own qualifiers did
+        ArrayList<VariableChange> variables;
+    };
+
+    ArrayList<LayoutChange> layouts;
+
+    inline bool isEmpty() const { return layouts.empty(); }
+};
+
+// Keeps the reflection of a single source buffer up to date while it is edited. Every
+// top level declaration the DeclarationScanner finds is parsed on its own and remembers
+// its byte range, so after an edit only the stretch of source between the last declaration
+// before the edit and the first one after it that ends in an unchanged place is scanned
+// again, and only declarations touched by an edit are lexed and parsed again. The results
+// of all others are copied over. Directives are not preprocessed.
+class ShaderReparser {
+    public:
+        // removedLength bytes at offset of the previous source were replaced by
+        // insertedLength bytes, which start at the same offset shifted by all earlier edits
+        struct Edit {
+            uint32 offset;
+            uint32 removedLength;
+            uint32 insertedLength;
+        };
+
+        explicit ShaderReparser(Memory::SharedPointer<StringInterner> interner
+                = StringInterner::getGlobal());
+
+        // parses source from scratch, the diff is against the previous reflection if any
+        bool parse(StringView source, ShaderDiff* diff = nullptr);
+        // Edits are sorted by offset, don't overlap and refer to the source of the previous
+        // call. After a failure the last good reflection is kept and the next call parses
+        // from scratch.
+        bool reparse(StringView source, const ArrayList<Edit>& edits, ShaderDiff& diff);
+
+        inline const ShaderInfo& getShaderInfo() const { return *shaderInfo; }
+        // the reflection before the last successful call, which the old indices of its diff
+        // refer to
+        inline const ShaderInfo& getPreviousShaderInfo() const { return *previousShaderInfo; }
+
+        // declarations lexed and parsed by the last call
+        inline uint32 getParsedCount() const { return parsedCount; }
+        // bytes of source scanned for declarations by the last call
+        inline uint32 getScannedSize() const { return scannedSize; }
+    private:
+        NULL_COPY_AND_ASSIGN(ShaderReparser);
+
+        static constexpr uint32 NOT_REUSED = ~0u;
+
+        struct Declaration {
+            uint32 begin;
+            uint32 end;
+            uint32 line;
+            uint32 endLine;
+
+            // what parsing the declaration added to the ShaderInfo
+            uint32 firstLayout;
+            uint32 layoutCount;
+            uint32 firstStruct;
+            uint32 structCount;
+
+            // declaration of the previous source with the same text, or NOT_REUSED
+            uint32 previous;
+        };
+
+        static void addDeclaration(StringView source, StringView region, uint32 line,
+                ArrayList<Declaration>& declarations);
+
+        // Parses or copies the results of every declaration into a new ShaderInfo, which
+        // replaces the current one on success. Once structsChanged is set, from firstChanged
+        // on, declarations are parsed again whenever they could use a struct.
+        bool build(StringView source, ArrayList<Declaration>& newDeclarations,
+                uint32 firstChanged, bool structsChanged, ShaderDiff* diff);
+
+        Memory::SharedPointer<StringInterner> interner;
+        Memory::UniquePointer<ShaderInfo> shaderInfo;
+        Memory::UniquePointer<ShaderInfo> previousShaderInfo;
+
+        String source;
+        ArrayList<Declaration> declarations;
+        // false until the first successful parse and after a failed one
+        bool valid = false;
+
+        uint32 parsedCount = 0;
+        uint32 scannedSize = 0;
+};
@@ -0,0 +1,325 @@
+#include "shader-source.hpp"
+
+#include "shader-stats.hpp"
+
+#include <engine/core/trace.hpp>
+#include <engine/core/util.hpp>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+	uint32 countLines(const char* begin, const char* end) {
+		return (uint32)std::count(begin, end, '\n');
+	}
+
+	bool parseIncludeName(StringView directive, StringView& name);
+};
+
+Memory::SharedPointer<ShaderSource::File> ShaderSource::File::load(const String& fileName,
+		StringView linkKeyword, bool cacheTokens) {
+	auto file = Memory::make_shared<File>();
+	file->name = fileName;
+	file->cacheTokens = cacheTokens;
+
+	if (!file->data.open(fileName)) {
+		DEBUG_LOG("File IO", LOG_ERROR, "Failed to load included file: %s", fileName.c_str());
+		return nullptr;
+	}
+
+	StringView text = file->data.getView();
+
+	size_t chunkStart = 0;
+	uint32 chunkLine = 1;
+	size_t pos;
+
+	while ((pos = text.find(linkKeyword, chunkStart)) != StringView::npos) {
+		size_t lineStart = text.rfind('\n', pos);
+		lineStart = lineStart == StringView::npos ? 0 : lineStart + 1;
+
+		size_t lineEnd = text.find('\n', pos);
+		lineEnd = lineEnd == StringView::npos ? text.size() : lineEnd + 1;
+
+		size_t nameStart = pos + linkKeyword.size();
+		StringView includeName;
+
+		if (!::parseIncludeName(text.substr(nameStart, lineEnd - nameStart), includeName)) {
+			DEBUG_LOG("File IO", LOG_ERROR, "Malformed include directive in %s",
+					fileName.c_str());
+			return nullptr;
+		}
+
+		if (lineStart > chunkStart) {
+			file->chunks.push_back({chunkLine, text.substr(chunkStart, lineStart - chunkStart),
+					StringView()});
+		}
+
+		chunkLine += ::countLines(text.data() + chunkStart, text.data() + lineStart);
+		file->chunks.push_back({chunkLine, text.substr(lineStart, lineEnd - lineStart),
+				includeName});
+
+		chunkLine += ::countLines(text.data() + lineStart, text.data() + lineEnd);
+		chunkStart = lineEnd;
+	}
+
+	if (chunkStart < text.size()) {
+		file->chunks.push_back({chunkLine, text.substr(chunkStart), StringView()});
+	}
+
+	return file;
+}
+
+const ArrayList<ShaderLexer::Token>* ShaderSource::File::getTokens(uint32 chunk) const {
+	if (!cacheTokens) {
+		return nullptr;
+	}
+
+	std::call_once(tokenizeFlag, [this] {
+		tokens.resize(chunks.size());
+
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (chunks[i].include.empty()) {
+				ShaderLexer::tokenizeShaderSource(chunks[i].text, name.c_str(), chunks[i].line,
+						tokens[i]);
+			}
+		}
+	});
+
+	return &tokens[chunk];
+}
+
+bool ShaderSource::load(const String& fileName, StringView linkKeyword) {
+	ShaderStats::Timer timer(ShaderStats::PHASE_LOAD);
+	Trace::Scope scope("Load", fileName);
+
+	files.clear();
+	includes.clear();
+	spans.clear();
+	includeStack.clear();
+
+	uint32 fileIndex;
+
+	return link(fileName, linkKeyword, nullptr, true, fileIndex);
+}
+
+bool ShaderSource::load(const String& fileName, IncludeCache& cache, StringView linkKeyword) {
+	ShaderStats::Timer timer(ShaderStats::PHASE_LOAD);
+	Trace::Scope scope("Load", fileName);
+
+	files.clear();
+	includes.clear();
+	spans.clear();
+	includeStack.clear();
+
+	uint32 fileIndex;
+
+	return link(fileName, linkKeyword, &cache, true, fileIndex);
+}
+
+const ArrayList<ShaderSource::Span>& ShaderSource::getSpans() const {
+	return spans;
+}
+
+uint32 ShaderSource::getFileCount() const {
+	return (uint32)files.size();
+}
+
+const ShaderSource::File& ShaderSource::getFile(uint32 index) const {
+	return *files[index];
+}
+
+const ArrayList<uint32>& ShaderSource::getIncludes(uint32 index) const {
+	return includes[index];
+}
+
+bool ShaderSource::link(const String& fileName, StringView linkKeyword, IncludeCache* cache,
+		bool isRoot, uint32& fileIndex) {
+	int32 index = findOrOpenFile(fileName, linkKeyword, cache, isRoot);
+
+	if (index == -1) {
+		return false;
+	}
+
+	fileIndex = (uint32)index;
+
+	if (std::find(includeStack.begin(), includeStack.end(), fileIndex) != includeStack.end()) {
+		DEBUG_LOG("File IO", LOG_ERROR, "Recursive include of file: %s", fileName.c_str());
+		return false;
+	}
+
+	includeStack.push_back(fileIndex);
+
+	// hold a reference, the file table may grow while linking includes
+	auto file = files[fileIndex];
+	String filePath = Util::getFilePath(file->getName());
+
+	const auto& chunks = file->getChunks();
+
+	for (uint32 i = 0; i < (uint32)chunks.size(); ++i) {
+		const auto& chunk = chunks[i];
+
+		if (chunk.include.empty()) {
+			spans.push_back({fileIndex, i, chunk.line, chunk.text});
+			continue;
+		}
+
+		uint32 includeIndex;
+
+		if (!link(filePath + String(chunk.include.data(), chunk.include.size()), linkKeyword,
+				cache, false, includeIndex)) {
+			includeStack.pop_back();
+			return false;
+		}
+
+		includes[fileIndex].push_back(includeIndex);
+	}
+
+	includeStack.pop_back();
+
+	return true;
+}
+
+int32 ShaderSource::findOrOpenFile(const String& fileName, StringView linkKeyword,
+		IncludeCache* cache, bool isRoot) {
+	Memory::SharedPointer<const File> file;
+
+	// the root shader is rarely shared, so only its includes go through the cache
+	if (cache != nullptr && !isRoot) {
+		file = cache->acquire(fileName, linkKeyword);
+	}
+	else {
+		for (size_t i = 0; i < files.size(); ++i) {
+			if (files[i]->getName() == fileName) {
+				return (int32)i;
+			}
+		}
+
+		file = File::load(fileName, linkKeyword, false);
+	}
+
+	if (!file) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (files[i] == file) {
+			return (int32)i;
+		}
+	}
+
+	files.push_back(std::move(file));
+	includes.emplace_back();
+
+	return (int32)(files.size() - 1);
+}
+
+IncludeCache& IncludeCache::getGlobal() {
+	static IncludeCache cache;
+	return cache;
+}
+
+Memory::SharedPointer<const ShaderSource::File> IncludeCache::acquire(const String& fileName,
+		StringView linkKeyword) {
+	Trace::Scope scope("Include", fileName);
+	std::error_code error;
+
+	std::filesystem::path canonicalPath = std::filesystem::canonical(fileName.c_str(), error);
+
+	if (error) {
+		DEBUG_LOG("File IO", LOG_ERROR, "Failed to load included file: %s", fileName.c_str());
+		return nullptr;
+	}
+
+	String key = canonicalPath.string();
+
+	int64 modifiedTime = (int64)std::filesystem::last_write_time(canonicalPath, error)
+			.time_since_epoch().count();
+	uint64 fileSize = error ? 0 : (uint64)std::filesystem::file_size(canonicalPath, error);
+
+	if (error) {
+		DEBUG_LOG("File IO", LOG_ERROR, "Failed to stat included file: %s", key.c_str());
+		return nullptr;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+
+		{
+			// waiting here is the contention between threads including the same headers
+			Trace::Scope wait("Include Lock");
+			lock.lock();
+		}
+
+		auto it = entries.find(key);
+
+		if (it != entries.end() && it->second.modifiedTime == modifiedTime
+				&& it->second.fileSize == fileSize && it->second.linkKeyword == linkKeyword) {
+			return it->second.file;
+		}
+	}
+
+	// load outside of the lock so unrelated headers can be loaded concurrently
+	Memory::SharedPointer<const ShaderSource::File> file = ShaderSource::File::load(key,
+			linkKeyword, true);
+
+	if (!file) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto& entry = entries[key];
+
+	if (entry.file && entry.modifiedTime == modifiedTime && entry.fileSize == fileSize
+			&& entry.linkKeyword == linkKeyword) {
+		// another thread loaded the same version first
+		return entry.file;
+	}
+
+	entry.modifiedTime = modifiedTime;
+	entry.fileSize = fileSize;
+	entry.linkKeyword = String(linkKeyword.data(), linkKeyword.size());
+	entry.file = file;
+
+	return file;
+}
+
+void IncludeCache::invalidate(const String& fileName) {
+	std::error_code error;
+
+	std::filesystem::path canonicalPath = std::filesystem::canonical(fileName.c_str(), error);
+	String key = error ? fileName : String(canonicalPath.string());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.erase(key);
+}
+
+void IncludeCache::invalidateAll() {
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+}
+
+size_t IncludeCache::getSize() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+namespace {
+	bool parseIncludeName(StringView directive, StringView& name) {
+		size_t start = directive.find_first_of("\"<");
+
+		if (start == StringView::npos) {
+			return false;
+		}
+
+		size_t end = directive.find(directive[start] == '"' ? '"' : '>', start + 1);
+
+		if (end == StringView::npos) {
+			return false;
+		}
+
+		name = directive.substr(start + 1, end - start - 1);
+
+		return true;
+	}
+};
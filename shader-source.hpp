@@ -0,0 +1,121 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/hash-map.hpp>
+#include <engine/core/memory.hpp>
+#include <engine/core/memory-mapped-file.hpp>
+
+#include "shader-lexer.hpp"
+
+#include <mutex>
+
+class IncludeCache;
+
+// A shader together with everything it includes. Every file is mapped exactly once into
+// the file table and the linked source is described as a list of spans (a rope) pointing
+// into those mappings, so included headers are never copied. Spans remember which file and
+// line they came from so tokens can be traced back to their real origin.
+class ShaderSource {
+	public:
+		// A mapped file split at its include directives. Files are immutable once loaded
+		// and may be shared between sources through an IncludeCache.
+		class File {
+			public:
+				struct Chunk {
+					uint32 line;
+					StringView text;
+					StringView include; // non-empty if this chunk is an include directive
+				};
+
+				static Memory::SharedPointer<File> load(const String& fileName,
+						StringView linkKeyword, bool cacheTokens);
+
+				inline const String& getName() const { return name; }
+				inline StringView getText() const { return data.getView(); }
+				inline const ArrayList<Chunk>& getChunks() const { return chunks; }
+
+				// tokens of a text chunk, or nullptr if this file does not keep its tokens
+				const ArrayList<ShaderLexer::Token>* getTokens(uint32 chunk) const;
+
+				File() = default;
+			private:
+				NULL_COPY_AND_ASSIGN(File);
+
+				String name;
+				MemoryMappedFile data;
+				ArrayList<Chunk> chunks;
+
+				bool cacheTokens;
+				mutable std::once_flag tokenizeFlag;
+				mutable ArrayList<ArrayList<ShaderLexer::Token>> tokens;
+		};
+
+		struct Span {
+			uint32 file;
+			uint32 chunk;
+			uint32 line; // line number of the first character of text inside its file
+			StringView text;
+		};
+
+		ShaderSource() = default;
+
+		bool load(const String& fileName, StringView linkKeyword = "#include");
+		// included files are fetched from and added to cache
+		bool load(const String& fileName, IncludeCache& cache,
+				StringView linkKeyword = "#include");
+
+		const ArrayList<Span>& getSpans() const;
+
+		uint32 getFileCount() const;
+		const File& getFile(uint32 index) const;
+		// file table indices included by a file, in include order
+		const ArrayList<uint32>& getIncludes(uint32 index) const;
+	private:
+		NULL_COPY_AND_ASSIGN(ShaderSource);
+
+		ArrayList<Memory::SharedPointer<const File>> files;
+		ArrayList<ArrayList<uint32>> includes;
+		ArrayList<Span> spans;
+
+		ArrayList<uint32> includeStack;
+
+		bool link(const String& fileName, StringView linkKeyword, IncludeCache* cache,
+				bool isRoot, uint32& fileIndex);
+		int32 findOrOpenFile(const String& fileName, StringView linkKeyword, IncludeCache* cache,
+				bool isRoot);
+};
+
+// Process-wide store of loaded include files, keyed by canonical path. An entry is reused
+// for as long as the file's modification time and size are unchanged, so a header shared
+// by many shaders is mapped, split and tokenized once.
+class IncludeCache {
+	public:
+		static IncludeCache& getGlobal();
+
+		IncludeCache() = default;
+
+		Memory::SharedPointer<const ShaderSource::File> acquire(const String& fileName,
+				StringView linkKeyword);
+
+		// drops the entry for a single file, sources already holding it are unaffected
+		void invalidate(const String& fileName);
+		void invalidateAll();
+
+		size_t getSize() const;
+	private:
+		NULL_COPY_AND_ASSIGN(IncludeCache);
+
+		struct Entry {
+			int64 modifiedTime;
+			uint64 fileSize;
+			String linkKeyword;
+			Memory::SharedPointer<const ShaderSource::File> file;
+		};
+
+		mutable std::mutex mutex;
+		HashMap<String, Entry> entries;
+};
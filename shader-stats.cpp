@@ -0,0 +1,93 @@
+#include "shader-stats.hpp"
+
+const char* ShaderStats::getPhaseName(Phase phase) {
+    switch (phase) {
+        case PHASE_LOAD:
+            return "Load";
+        case PHASE_PREPROCESS:
+            return "Preprocess";
+        case PHASE_LEX:
+            return "Lex";
+        case PHASE_PARSE:
+            return "Parse";
+        case PHASE_LAYOUT:
+            return "Layout";
+        case PHASE_LAYOUT_OPTIONS:
+            return "Layout Options";
+        case PHASE_LAYOUT_QUALIFIERS:
+            return "Layout Qualifiers";
+        case PHASE_LAYOUT_VARIABLES:
+            return "Layout Variables";
+        case PHASE_STRUCT:
+            return "Struct";
+        case PHASE_MEMBERS:
+            return "Members";
+        case PHASE_MEMORY_LAYOUT:
+            return "Memory Layout";
+        case PHASE_SERIALIZE:
+            return "Serialize";
+        default:
+            return "Unknown";
+    }
+}
+
+uint64 ShaderStats::getTotalTime() const {
+    uint64 total = 0;
+
+    for (uint64 time : phaseTimes) {
+        total += time;
+    }
+
+    return total;
+}
+
+void ShaderStats::add(const ShaderStats& other) {
+    for (uint32 i = 0; i < PHASE_COUNT; ++i) {
+        phaseTimes[i] += other.phaseTimes[i];
+    }
+
+    sourceBytes += other.sourceBytes;
+    tokens += other.tokens;
+    allocations += other.allocations;
+    frees += other.frees;
+    allocatedBytes += other.allocatedBytes;
+}
+
+#if ENABLE_STATS
+
+ShaderStats::Collect::Collect(ShaderStats& stats) {
+    ShaderStatsDetail::ThreadState& state = ShaderStatsDetail::threadState;
+
+    nested = state.stats == &stats;
+
+    if (nested) {
+        return;
+    }
+
+    previous = state;
+    state = ShaderStatsDetail::ThreadState();
+    state.stats = &stats;
+    state.allocationsAtStart = Memory::getAllocationStats();
+}
+
+ShaderStats::Collect::~Collect() {
+    if (nested) {
+        return;
+    }
+
+    ShaderStatsDetail::ThreadState& state = ShaderStatsDetail::threadState;
+    ShaderStats& stats = *state.stats;
+
+    for (uint32 i = 0; i < PHASE_COUNT; ++i) {
+        stats.phaseTimes[i] += Clock::toNanoseconds(state.ticks[i]);
+    }
+
+    Memory::AllocationStats allocations = Memory::getAllocationStats();
+    stats.allocations += allocations.allocations - state.allocationsAtStart.allocations;
+    stats.frees += allocations.frees - state.allocationsAtStart.frees;
+    stats.allocatedBytes += allocations.allocatedBytes - state.allocationsAtStart.allocatedBytes;
+
+    state = previous;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/clock.hpp>
+#include <engine/core/memory.hpp>
+
+// Where the time and memory of reflecting a shader went. Phases are timed exclusively:
+// while a nested phase runs, such as the lexing a parse pulls in token by token, the
+// enclosing one is paused, so the phase times add up to the time spent in all of them.
+// Allocations count the calls of Memory::malloc and Memory::free. Everything stays zero
+// when stats are compiled out.
+struct ShaderStats {
+    enum Phase {
+        PHASE_LOAD,
+        PHASE_PREPROCESS,
+        PHASE_LEX,
+        // the top level of the parser, between declarations
+        PHASE_PARSE,
+        PHASE_LAYOUT,
+        PHASE_LAYOUT_OPTIONS,
+        PHASE_LAYOUT_QUALIFIERS,
+        PHASE_LAYOUT_VARIABLES,
+        PHASE_STRUCT,
+        PHASE_MEMBERS,
+        PHASE_MEMORY_LAYOUT,
+        // reading and writing the ShaderBinary format, including the cache files
+        PHASE_SERIALIZE,
+
+        PHASE_COUNT
+    };
+
+    class Collect;
+    class Timer;
+
+    // nanoseconds
+    uint64 phaseTimes[PHASE_COUNT] = {};
+
+    // bytes of source handed to the lexer or the declaration scanner
+    uint64 sourceBytes = 0;
+    // tokens lexed or taken from the token cache of an included file, before preprocessing
+    uint64 tokens = 0;
+
+    uint64 allocations = 0;
+    uint64 frees = 0;
+    uint64 allocatedBytes = 0;
+
+    static const char* getPhaseName(Phase phase);
+
+    uint64 getTotalTime() const;
+    void add(const ShaderStats& other);
+
+    // adds to the stats the calling thread collects into, if any
+    static void addSource(uint64 bytes);
+    static void addTokens(uint64 count);
+};
+
+namespace ShaderStatsDetail {
+#if ENABLE_STATS
+    struct ThreadState {
+        ShaderStats* stats = nullptr;
+        // the running phase, PHASE_COUNT while no timer is
+        ShaderStats::Phase phase = ShaderStats::PHASE_COUNT;
+        uint64 phaseStart = 0;
+        uint64 ticks[ShaderStats::PHASE_COUNT] = {};
+        Memory::AllocationStats allocationsAtStart;
+    };
+
+    inline thread_local ThreadState threadState;
+#endif
+};
+
+// Collects what the calling thread does while it is alive into stats. Collecting into the
+// stats that are already being collected into does nothing, any other stats take over until
+// the Collect ends.
+class ShaderStats::Collect {
+    public:
+#if ENABLE_STATS
+        explicit Collect(ShaderStats& stats);
+        ~Collect();
+#else
+        inline explicit Collect(ShaderStats&) {}
+#endif
+    private:
+        NULL_COPY_AND_ASSIGN(Collect);
+
+#if ENABLE_STATS
+        bool nested;
+        ShaderStatsDetail::ThreadState previous;
+#endif
+};
+
+// Times phase for as long as it is alive, if the calling thread is collecting stats
+class ShaderStats::Timer {
+    public:
+#if ENABLE_STATS
+        FORCEINLINE explicit Timer(Phase phase) {
+            ShaderStatsDetail::ThreadState& state = ShaderStatsDetail::threadState;
+
+            if (state.stats == nullptr) {
+                previous = PHASE_COUNT + 1;
+                return;
+            }
+
+            uint64 now = Clock::now();
+
+            if (state.phase != PHASE_COUNT) {
+                state.ticks[state.phase] += now - state.phaseStart;
+            }
+
+            previous = state.phase;
+            state.phase = phase;
+            state.phaseStart = now;
+        }
+
+        FORCEINLINE ~Timer() {
+            ShaderStatsDetail::ThreadState& state = ShaderStatsDetail::threadState;
+
+            if (previous > PHASE_COUNT || state.stats == nullptr) {
+                return;
+            }
+
+            uint64 now = Clock::now();
+
+            state.ticks[state.phase] += now - state.phaseStart;
+            state.phase = (Phase)previous;
+            state.phaseStart = now;
+        }
+#else
+        inline explicit Timer(Phase) {}
+#endif
+    private:
+        NULL_COPY_AND_ASSIGN(Timer);
+
+#if ENABLE_STATS
+        // PHASE_COUNT + 1 if the thread was not collecting when the timer started
+        uint32 previous;
+#endif
+};
+
+inline void ShaderStats::addSource(uint64 bytes) {
+#if ENABLE_STATS
+    if (ShaderStats* stats = ShaderStatsDetail::threadState.stats) {
+        stats->sourceBytes += bytes;
+    }
+#endif
+}
+
+inline void ShaderStats::addTokens(uint64 count) {
+#if ENABLE_STATS
+    if (ShaderStats* stats = ShaderStatsDetail::threadState.stats) {
+        stats->tokens += count;
+    }
+#endif
+}
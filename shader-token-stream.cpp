@@ -0,0 +1,217 @@
+#include "shader-token-stream.hpp"
+
+#include "shader-preprocessor.hpp"
+#include "shader-source.hpp"
+#include "shader-stats.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+
+ShaderLexer::TokenStream::TokenStream(StringView source, const char* fileName,
+        bool declarationsOnly, uint32 line)
+        : fileName(fileName)
+        , text(source)
+        , textLine(line)
+        , declarationsOnly(declarationsOnly) {
+    ShaderStats::addSource(source.size());
+
+    if (declarationsOnly) {
+        scanner.setSource(source, line);
+    }
+    else {
+        lexer.reset(source, fileName, line);
+    }
+}
+
+ShaderLexer::TokenStream::TokenStream(const ShaderSource& source, bool declarationsOnly)
+        : source(&source)
+        , declarationsOnly(declarationsOnly) {}
+
+ShaderLexer::TokenStream::TokenStream(const ArrayList<Token>& tokens)
+        : declarationsOnly(false)
+        , cachedTokens(&tokens) {}
+
+ShaderLexer::TokenStream::~TokenStream() {}
+
+void ShaderLexer::TokenStream::preprocess(const ShaderDefines& defines) {
+    preprocessor = Memory::make_unique<ShaderPreprocessor>(defines);
+}
+
+const ShaderLexer::Token* ShaderLexer::TokenStream::next() {
+    if (buffered > 0) {
+        current = ring[head];
+        head = (head + 1) % LOOKAHEAD;
+        --buffered;
+
+        return &current;
+    }
+
+    return produce(current) ? &current : nullptr;
+}
+
+const ShaderLexer::Token* ShaderLexer::TokenStream::peek(uint32 offset) {
+    while (buffered <= offset) {
+        if (!produce(ring[(head + buffered) % LOOKAHEAD])) {
+            return nullptr;
+        }
+
+        ++buffered;
+    }
+
+    return &ring[(head + offset) % LOOKAHEAD];
+}
+
+bool ShaderLexer::TokenStream::hasError() const {
+    return preprocessor != nullptr && preprocessor->hasError();
+}
+
+void ShaderLexer::TokenStream::setDiagnostics(ArrayList<Diagnostic>* diagnostics) {
+    this->diagnostics = diagnostics;
+}
+
+void ShaderLexer::TokenStream::report(const Token* token, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    addDiagnostic(Diagnostic::Severity::ERROR, token, format, args);
+    va_end(args);
+}
+
+void ShaderLexer::TokenStream::warn(const Token* token, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    addDiagnostic(Diagnostic::Severity::WARNING, token, format, args);
+    va_end(args);
+}
+
+void ShaderLexer::TokenStream::addDiagnostic(Diagnostic::Severity severity, const Token* token,
+        const char* format, va_list args) {
+    char message[512];
+    vsnprintf(message, sizeof(message), format, args);
+
+    Diagnostic diagnostic = {"", 0, 0, message, severity};
+
+    if (token != nullptr) {
+        diagnostic.fileName = token->fileName;
+        diagnostic.line = token->line;
+        diagnostic.column = getColumn(*token);
+    }
+    else if (current.type != Token::TYPE_INVALID) {
+        diagnostic.fileName = current.fileName;
+        diagnostic.line = current.line;
+    }
+    else if (fileName != nullptr) {
+        diagnostic.fileName = fileName;
+    }
+
+    if (diagnostics != nullptr) {
+        diagnostics->push_back(std::move(diagnostic));
+    }
+    else {
+        ShaderLexer::logDiagnostic(diagnostic);
+    }
+}
+
+bool ShaderLexer::TokenStream::produce(Token& token) {
+    if (preprocessor != nullptr) {
+        ShaderStats::Timer timer(ShaderStats::PHASE_PREPROCESS);
+        return preprocessor->next(*this, token);
+    }
+
+    return produceRaw(token);
+}
+
+bool ShaderLexer::TokenStream::produceRaw(Token& token) {
+    ShaderStats::Timer timer(ShaderStats::PHASE_LEX);
+
+    for (;;) {
+        if (cachedTokens != nullptr) {
+            if (cachedIndex < cachedTokens->size()) {
+                token = (*cachedTokens)[cachedIndex++];
+                ShaderStats::addTokens(1);
+
+                return true;
+            }
+
+            cachedTokens = nullptr;
+        }
+
+        if (lexer.next(token)) {
+            ShaderStats::addTokens(1);
+            return true;
+        }
+
+        if (declarationsOnly) {
+            StringView region;
+            uint32 regionLine;
+
+            if (scanner.nextRegion(region, regionLine)) {
+                lexer.reset(region, fileName, regionLine);
+                continue;
+            }
+        }
+
+        if (!nextSpan()) {
+            return false;
+        }
+    }
+}
+
+bool ShaderLexer::TokenStream::nextSpan() {
+    if (source == nullptr || spanIndex == source->getSpans().size()) {
+        return false;
+    }
+
+    const auto& span = source->getSpans()[spanIndex++];
+    const auto& file = source->getFile(span.file);
+
+    fileName = file.getName().c_str();
+    ShaderStats::addSource(span.text.size());
+
+    // the scanner tracks braces across spans, so it can't jump over cached tokens
+    if (declarationsOnly) {
+        scanner.setSource(span.text, span.line);
+    }
+    else if ((cachedTokens = file.getTokens(span.chunk)) != nullptr) {
+        cachedIndex = 0;
+    }
+    else {
+        lexer.reset(span.text, fileName, span.line);
+    }
+
+    return true;
+}
+
+uint32 ShaderLexer::TokenStream::getColumn(const Token& token) const {
+    const char* c = token.data.data();
+    StringView container = text;
+    uint32 line = textLine;
+
+    if (source != nullptr) {
+        container = StringView();
+
+        for (const auto& span : source->getSpans()) {
+            if (c >= span.text.data() && c < span.text.data() + span.text.size()) {
+                container = span.text;
+                line = span.line;
+
+                break;
+            }
+        }
+    }
+
+    if (c < container.data() || c >= container.data() + container.size()) {
+        return 0;
+    }
+
+    const char* lineStart = container.data();
+
+    for (const char* i = container.data(); i < c; ++i) {
+        if (*i == '\n') {
+            lineStart = i + 1;
+            ++line;
+        }
+    }
+
+    // tokens expanded from a macro body carry the line of the invocation
+    return line == token.line ? (uint32)(c - lineStart) + 1 : 0;
+}
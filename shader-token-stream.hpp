@@ -0,0 +1,99 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+#include <engine/core/string-view.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/memory.hpp>
+
+#include "shader-lexer.hpp"
+
+#include <cstdarg>
+
+class ShaderDefines;
+class ShaderPreprocessor;
+class ShaderSource;
+
+namespace ShaderLexer {
+    // Pulls tokens out of a source on demand instead of tokenizing all of it up front. Only
+    // a fixed window of LOOKAHEAD tokens is ever buffered, so memory use does not grow with
+    // the size of the source. A linked source is walked span by span, reusing the tokens its
+    // files cached when there are any. Unless preprocess() is called, directives are passed
+    // through as plain tokens.
+    class TokenStream {
+        public:
+            static constexpr uint32 LOOKAHEAD = 4;
+
+            // declarationsOnly streams only what a DeclarationScanner finds in the source, line
+            // is the line number source starts on
+            TokenStream(StringView source, const char* fileName, bool declarationsOnly = false,
+                    uint32 line = 1);
+            TokenStream(const ShaderSource& source, bool declarationsOnly = false);
+            // streams tokens that were lexed before, tokens must outlive the stream
+            explicit TokenStream(const ArrayList<Token>& tokens);
+
+            ~TokenStream();
+
+            // runs the stream through a ShaderPreprocessor, must be called before the first
+            // token is pulled and defines must outlive the stream
+            void preprocess(const ShaderDefines& defines);
+
+            // consumes a token, the pointer stays valid until the next call to next,
+            // nullptr at the end of the source
+            const Token* next();
+            // looks offset tokens past the next one without consuming anything,
+            // offset must be less than LOOKAHEAD
+            const Token* peek(uint32 offset = 0);
+
+            // true if the stream ended early because the preprocessor failed
+            bool hasError() const;
+
+            // errors of the parser and the preprocessor are added to diagnostics instead of
+            // being logged, diagnostics must outlive the stream
+            void setDiagnostics(ArrayList<Diagnostic>* diagnostics);
+            // reports an error at token, or after the last token pulled if token is nullptr
+            void report(const Token* token, const char* format, ...);
+            // the same as report() for a problem that doesn't fail the parse, token can be a
+            // copy of one the stream returned
+            void warn(const Token* token, const char* format, ...);
+        private:
+            NULL_COPY_AND_ASSIGN(TokenStream);
+
+            friend class ::ShaderPreprocessor;
+
+            bool produce(Token& token);
+            // next token before preprocessing
+            bool produceRaw(Token& token);
+            bool nextSpan();
+
+            void addDiagnostic(Diagnostic::Severity severity, const Token* token,
+                    const char* format, va_list args);
+
+            // column of token, if it lies in the text of the source on the line it reports
+            uint32 getColumn(const Token& token) const;
+
+            const ShaderSource* source = nullptr;
+            uint32 spanIndex = 0;
+            const char* fileName = nullptr;
+            // the source when it is not a ShaderSource, and the line it starts on
+            StringView text;
+            uint32 textLine = 1;
+
+            bool declarationsOnly;
+
+            Lexer lexer;
+            DeclarationScanner scanner;
+            Memory::UniquePointer<ShaderPreprocessor> preprocessor;
+
+            const ArrayList<Token>* cachedTokens = nullptr;
+            uint32 cachedIndex = 0;
+
+            Token ring[LOOKAHEAD];
+            uint32 head = 0;
+            uint32 buffered = 0;
+
+            Token current;
+
+            ArrayList<Diagnostic>* diagnostics = nullptr;
+    };
+};
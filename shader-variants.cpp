@@ -0,0 +1,493 @@
+#include "shader-variants.hpp"
+
+#include "shader-lexer.hpp"
+#include "shader-preprocessor.hpp"
+#include "shader-source.hpp"
+#include "shader-token-stream.hpp"
+
+#include <engine/core/hash.hpp>
+#include <engine/core/hash-map.hpp>
+#include <engine/core/hash-set.hpp>
+#include <engine/core/string.hpp>
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+    using Token = ShaderLexer::Token;
+
+    // file name of the tokens that stand in for the contents of a group
+    constexpr const char* MARKER_FILE_NAME = "<group marker>";
+
+    struct Analysis {
+        // Every directive of the source. A directive opening a group that can change the
+        // interface is followed by a marker token whose line is the group's index, so
+        // preprocessing these tokens outputs exactly the markers of the groups a variant keeps.
+        ArrayList<Token> directives;
+        // names whose definitions can change how the declarations expand
+        HashSet<StringView> expandedNames;
+    };
+
+    // chains the bytes of a scalar onto hash
+    template <typename T>
+    inline uint64 hashValue(T value, uint64 hash) {
+        return Hash::hash64(&value, sizeof(T), hash);
+    }
+
+    void analyze(const ArrayList<Token>& tokens, const ArrayList<ShaderDefines>& variants,
+            Analysis& analysis);
+    // calls onDirective for every directive, the # included, and onToken for every other token
+    template <typename DirectiveFunc, typename TokenFunc>
+    void walkTokens(const ArrayList<Token>& tokens, DirectiveFunc&& onDirective,
+            TokenFunc&& onToken);
+
+    // false if the variant's directives fail
+    bool getVariantKey(const Analysis& analysis, const ShaderDefines& variant, String& key);
+
+    uint64 hashLayouts(const ShaderInfo& shaderInfo);
+    bool equalLayouts(const ShaderInfo& a, const ShaderInfo& b);
+    bool equalVariables(const ShaderInfo& a, const Memory::ArenaArray<ShaderInfo::Variable>& varsA,
+            const ShaderInfo& b, const Memory::ArenaArray<ShaderInfo::Variable>& varsB);
+
+    bool isWord(const Token& token);
+};
+
+bool ShaderVariants::reflect(const ShaderSource& source, const ArrayList<ShaderDefines>& variants,
+        ShaderInfo::ScanMode mode) {
+    interfaces.clear();
+    variantInterfaces.assign(variants.size(), FAILED_INTERFACE);
+    parseCount = 0;
+
+    // directives are kept as plain tokens here, each variant evaluates them on its own
+    ArrayList<Token> tokens;
+    ShaderLexer::TokenStream lexer(source, mode == ShaderInfo::ScanMode::DECLARATIONS);
+
+    while (const Token* token = lexer.next()) {
+        tokens.push_back(*token);
+    }
+
+    Analysis analysis;
+    ::analyze(tokens, variants, analysis);
+
+    HashMap<String, uint32> keyInterfaces;
+    bool succeeded = true;
+
+    for (size_t i = 0; i < variants.size(); ++i) {
+        String key;
+
+        if (!::getVariantKey(analysis, variants[i], key)) {
+            succeeded = false;
+            continue;
+        }
+
+        auto it = keyInterfaces.find(key);
+
+        if (it != keyInterfaces.end()) {
+            variantInterfaces[i] = it->second;
+            succeeded = succeeded && it->second != FAILED_INTERFACE;
+
+            continue;
+        }
+
+        ShaderLexer::TokenStream stream(tokens);
+        stream.preprocess(variants[i]);
+
+        auto shaderInfo = Memory::make_shared<ShaderInfo>();
+        uint32 index = FAILED_INTERFACE;
+
+        ++parseCount;
+
+        bool parsed = shaderInfo->parse(stream);
+
+        // a variant either reflects completely or not at all, its errors are not kept and
+        // neither are the warnings of one that parsed
+        for (const auto& diagnostic : shaderInfo->getDiagnostics()) {
+            ShaderLexer::logDiagnostic(diagnostic);
+        }
+
+        if (parsed) {
+            uint64 hash = ::hashLayouts(*shaderInfo);
+
+            for (uint32 j = 0; j < interfaces.size() && index == FAILED_INTERFACE; ++j) {
+                if (interfaces[j].hash == hash && ::equalLayouts(*interfaces[j].shaderInfo, *shaderInfo)) {
+                    index = j;
+                }
+            }
+
+            if (index == FAILED_INTERFACE) {
+                index = (uint32)interfaces.size();
+                interfaces.push_back({hash, std::move(shaderInfo)});
+            }
+        }
+        else {
+            succeeded = false;
+        }
+
+        variantInterfaces[i] = index;
+        keyInterfaces.emplace(std::move(key), index);
+    }
+
+    return succeeded;
+}
+
+const ShaderInfo* ShaderVariants::getShaderInfo(uint32 variant) const {
+    uint32 index = variantInterfaces[variant];
+
+    return index != FAILED_INTERFACE ? interfaces[index].shaderInfo.get() : nullptr;
+}
+
+uint64 ShaderVariants::getInterfaceHash(uint32 variant) const {
+    uint32 index = variantInterfaces[variant];
+
+    return index != FAILED_INTERFACE ? interfaces[index].hash : 0;
+}
+
+namespace {
+    void analyze(const ArrayList<Token>& tokens, const ArrayList<ShaderDefines>& variants,
+            Analysis& analysis) {
+        HashSet<StringView> macroNames;
+
+        for (const auto& variant : variants) {
+            for (const auto& define : variant.getDefines()) {
+                macroNames.insert(define.first);
+            }
+        }
+
+        // macros defined by the source, whatever groups they are in
+        ::walkTokens(tokens, [&](const Token* begin, const Token* end) {
+            if (end - begin < 3 || begin[1].data != "define") {
+                return;
+            }
+
+            macroNames.insert(begin[2].data);
+
+            for (const Token* token = begin + 3; token != end; ++token) {
+                if (::isWord(*token)) {
+                    analysis.expandedNames.insert(token->data);
+                }
+            }
+        }, [](const Token&) {});
+
+        ArrayList<uint32> openGroups;
+        ArrayList<bool> relevantGroups;
+
+        auto markOpenGroups = [&] {
+            // the enclosing groups are marked together with a group, so they are done already
+            if (!openGroups.empty() && !relevantGroups[openGroups.back()]) {
+                for (uint32 group : openGroups) {
+                    relevantGroups[group] = true;
+                }
+            }
+        };
+
+        auto openGroup = [&] {
+            openGroups.push_back((uint32)relevantGroups.size());
+            analysis.directives.push_back({Token::TYPE_INVALID, (uint32)relevantGroups.size(),
+                    StringView(), ::MARKER_FILE_NAME});
+            relevantGroups.push_back(false);
+        };
+
+        bool inLayout = false;
+        uint32 depth = 0;
+
+        ::walkTokens(tokens, [&](const Token* begin, const Token* end) {
+            analysis.directives.insert(analysis.directives.end(), begin, end);
+
+            StringView name = end - begin > 1 ? begin[1].data : StringView();
+
+            if (name == "if" || name == "ifdef" || name == "ifndef") {
+                openGroup();
+            }
+            else if (name == "elif" || name == "else") {
+                if (!openGroups.empty()) {
+                    openGroups.pop_back();
+                }
+
+                openGroup();
+            }
+            else if (name == "endif") {
+                if (!openGroups.empty()) {
+                    openGroups.pop_back();
+                }
+            }
+            else if (name == "define" || name == "undef" || name == "error") {
+                markOpenGroups();
+            }
+        }, [&](const Token& token) {
+            // struct definitions shape the blocks that use them
+            if ((token.type == Token::TYPE_LAYOUT || (token.type == Token::TYPE_KEYWORD
+                    && token.data == "struct")) && !inLayout) {
+                inLayout = true;
+                depth = 0;
+            }
+
+            if (inLayout) {
+                markOpenGroups();
+
+                if (::isWord(token)) {
+                    analysis.expandedNames.insert(token.data);
+                }
+                else if (token.type == Token::TYPE_OPEN_CURLY) {
+                    ++depth;
+                }
+                else if (token.type == Token::TYPE_CLOSE_CURLY && depth > 0) {
+                    --depth;
+                }
+                else if (token.type == Token::TYPE_SEMI_COLON && depth == 0) {
+                    inLayout = false;
+                }
+            }
+            else if (::isWord(token) && macroNames.count(token.data) != 0) {
+                markOpenGroups();
+                analysis.expandedNames.insert(token.data);
+            }
+        });
+
+        auto& directives = analysis.directives;
+
+        directives.erase(std::remove_if(directives.begin(), directives.end(), [&](const Token& token) {
+            return token.fileName == ::MARKER_FILE_NAME && !relevantGroups[token.line];
+        }), directives.end());
+    }
+
+    template <typename DirectiveFunc, typename TokenFunc>
+    void walkTokens(const ArrayList<Token>& tokens, DirectiveFunc&& onDirective,
+            TokenFunc&& onToken) {
+        uint32 previousLine = 0;
+        const char* previousFileName = nullptr;
+
+        for (size_t i = 0; i < tokens.size();) {
+            const Token& token = tokens[i];
+
+            if (token.type != Token::TYPE_POUND_SIGN || (token.line == previousLine
+                    && token.fileName == previousFileName)) {
+                onToken(token);
+
+                previousLine = token.line;
+                previousFileName = token.fileName;
+                ++i;
+
+                continue;
+            }
+
+            size_t end = i + 1;
+            uint32 line = token.line;
+
+            for (; end < tokens.size() && tokens[end].line == line
+                    && tokens[end].fileName == token.fileName; ++end) {
+                // a backslash continues the directive on the next line
+                if (tokens[end].data == "\\") {
+                    ++line;
+                }
+            }
+
+            onDirective(tokens.data() + i, tokens.data() + end);
+
+            previousLine = tokens[end - 1].line;
+            previousFileName = token.fileName;
+            i = end;
+        }
+    }
+
+    bool getVariantKey(const Analysis& analysis, const ShaderDefines& variant, String& key) {
+        ShaderLexer::TokenStream stream(analysis.directives);
+        stream.preprocess(variant);
+
+        ArrayList<uint32> groups;
+
+        while (const Token* marker = stream.next()) {
+            groups.push_back(marker->line);
+        }
+
+        if (stream.hasError()) {
+            return false;
+        }
+
+        // the values of the macros the declarations expand, followed into the names those
+        // values mention in turn
+        ArrayList<const Pair<const String, String>*> pending;
+        ArrayList<const Pair<const String, String>*> used;
+
+        for (const auto& define : variant.getDefines()) {
+            if (analysis.expandedNames.count(define.first) != 0) {
+                pending.push_back(&define);
+            }
+        }
+
+        while (!pending.empty()) {
+            auto* define = pending.back();
+            pending.pop_back();
+
+            if (std::find(used.begin(), used.end(), define) != used.end()) {
+                continue;
+            }
+
+            used.push_back(define);
+
+            ArrayList<Token> valueTokens;
+            ShaderLexer::tokenizeShaderSource(define->second, "", 1, valueTokens);
+
+            for (const auto& token : valueTokens) {
+                auto it = ::isWord(token) ? variant.getDefines().find(String(token.data.data(),
+                        token.data.size())) : variant.getDefines().end();
+
+                if (it != variant.getDefines().end()) {
+                    pending.push_back(&*it);
+                }
+            }
+        }
+
+        std::sort(used.begin(), used.end(), [](auto* a, auto* b) { return a->first < b->first; });
+
+        uint32 groupCount = (uint32)groups.size();
+
+        key.append(reinterpret_cast<const char*>(&groupCount), sizeof(groupCount));
+        key.append(reinterpret_cast<const char*>(groups.data()), groups.size() * sizeof(uint32));
+
+        for (auto* define : used) {
+            key.append(define->first);
+            key.push_back('=');
+            key.append(define->second);
+            key.push_back('\0');
+        }
+
+        return true;
+    }
+
+    uint64 hashLayouts(const ShaderInfo& shaderInfo) {
+        uint64 hash = ::hashValue((uint64)shaderInfo.getLayoutInfo().size(), 0);
+
+        for (const auto& layout : shaderInfo.getLayoutInfo()) {
+            hash = ::hashValue((uint32)layout.type, hash);
+            hash = Hash::hash64(shaderInfo.getString(layout.name), hash);
+            hash = Hash::hash64(shaderInfo.getString(layout.typeQualifier), hash);
+            hash = ::hashValue(layout.isArray, hash);
+            hash = ::hashValue(layout.arraySize, hash);
+            hash = Hash::hash64(shaderInfo.getString(layout.defaultValue), hash);
+
+            hash = ::hashValue(layout.options.size(), hash);
+
+            for (const auto& option : layout.options) {
+                hash = Hash::hash64(shaderInfo.getString(option.name), hash);
+                hash = ::hashValue(option.value, hash);
+            }
+
+            hash = ::hashValue(layout.memoryQualifiers.size(), hash);
+
+            for (auto qualifier : layout.memoryQualifiers) {
+                hash = Hash::hash64(shaderInfo.getString(qualifier), hash);
+            }
+
+            hash = ::hashValue(layout.body.size(), hash);
+
+            for (const auto& var : layout.body) {
+                hash = Hash::hash64(shaderInfo.getString(var.typeName), hash);
+                hash = Hash::hash64(shaderInfo.getString(var.name), hash);
+                hash = ::hashValue(var.isArray, hash);
+                hash = ::hashValue(var.arraySize, hash);
+            }
+
+            // covers the definitions of the structs the block uses
+            hash = ::hashValue(layout.flattenedBody.size(), hash);
+
+            for (const auto& var : layout.flattenedBody) {
+                hash = Hash::hash64(shaderInfo.getString(var.typeName), hash);
+                hash = Hash::hash64(shaderInfo.getString(var.name), hash);
+                hash = ::hashValue(var.offset, hash);
+            }
+        }
+
+        hash = ::hashValue((uint64)shaderInfo.getStructTypes().size(), hash);
+
+        for (const auto& structType : shaderInfo.getStructTypes()) {
+            hash = Hash::hash64(shaderInfo.getString(structType.name), hash);
+            hash = ::hashValue(structType.members.size(), hash);
+
+            for (const auto& var : structType.members) {
+                hash = Hash::hash64(shaderInfo.getString(var.typeName), hash);
+                hash = Hash::hash64(shaderInfo.getString(var.name), hash);
+                hash = ::hashValue(var.isArray, hash);
+                hash = ::hashValue(var.arraySize, hash);
+            }
+        }
+
+        // 0 is left to failed variants
+        return hash != 0 ? hash : 1;
+    }
+
+    bool equalLayouts(const ShaderInfo& a, const ShaderInfo& b) {
+        const auto& layoutsA = a.getLayoutInfo();
+        const auto& layoutsB = b.getLayoutInfo();
+
+        const auto& structsA = a.getStructTypes();
+        const auto& structsB = b.getStructTypes();
+
+        if (layoutsA.size() != layoutsB.size() || structsA.size() != structsB.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < structsA.size(); ++i) {
+            if (a.getString(structsA[i].name) != b.getString(structsB[i].name)
+                    || !::equalVariables(a, structsA[i].members, b, structsB[i].members)) {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < layoutsA.size(); ++i) {
+            const auto& la = layoutsA[i];
+            const auto& lb = layoutsB[i];
+
+            if (la.type != lb.type || a.getString(la.name) != b.getString(lb.name)
+                    || a.getString(la.typeQualifier) != b.getString(lb.typeQualifier)
+                    || la.isArray != lb.isArray || la.arraySize != lb.arraySize
+                    || a.getString(la.defaultValue) != b.getString(lb.defaultValue)
+                    || la.options.size() != lb.options.size()
+                    || la.memoryQualifiers.size() != lb.memoryQualifiers.size()
+                    || !::equalVariables(a, la.body, b, lb.body)
+                    || !::equalVariables(a, la.flattenedBody, b, lb.flattenedBody)) {
+                return false;
+            }
+
+            for (uint32 j = 0; j < la.options.size(); ++j) {
+                if (a.getString(la.options[j].name) != b.getString(lb.options[j].name)
+                        || la.options[j].value != lb.options[j].value) {
+                    return false;
+                }
+            }
+
+            for (uint32 j = 0; j < la.memoryQualifiers.size(); ++j) {
+                if (a.getString(la.memoryQualifiers[j]) != b.getString(lb.memoryQualifiers[j])) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool equalVariables(const ShaderInfo& a, const Memory::ArenaArray<ShaderInfo::Variable>& varsA,
+            const ShaderInfo& b, const Memory::ArenaArray<ShaderInfo::Variable>& varsB) {
+        if (varsA.size() != varsB.size()) {
+            return false;
+        }
+
+        for (uint32 i = 0; i < varsA.size(); ++i) {
+            const auto& va = varsA[i];
+            const auto& vb = varsB[i];
+
+            if (a.getString(va.typeName) != b.getString(vb.typeName)
+                    || a.getString(va.name) != b.getString(vb.name)
+                    || va.isArray != vb.isArray || va.arraySize != vb.arraySize
+                    || va.offset != vb.offset) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool isWord(const Token& token) {
+        return !token.data.empty() && (std::isalpha((unsigned char)token.data[0])
+                || token.data[0] == '_');
+    }
+};
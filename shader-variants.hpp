@@ -0,0 +1,54 @@
+#pragma once
+
+#include <engine/core/common.hpp>
+
+#include <engine/core/array-list.hpp>
+#include <engine/core/memory.hpp>
+
+#include "shader-parser.hpp"
+
+class ShaderDefines;
+class ShaderSource;
+
+// Reflects many define sets (permutations) of one shader while doing the work once per
+// distinct interface. The source is lexed a single time and analyzed for the conditional
+// groups that can change the layouts, either by containing layout declarations or by
+// defining macros the declarations use. Variants are then told apart by evaluating only the
+// directives: permutations that keep the same of those groups and give the same values to
+// the macros the declarations expand are parsed once. Parsed results that come out equal
+// are merged as well, so every variant maps to a shared ShaderInfo identified by a hash of
+// its layouts.
+class ShaderVariants {
+    public:
+        ShaderVariants() = default;
+
+        // variants must stay alive for the duration of the call
+        bool reflect(const ShaderSource& source, const ArrayList<ShaderDefines>& variants,
+                ShaderInfo::ScanMode mode = ShaderInfo::ScanMode::FULL);
+
+        inline uint32 getVariantCount() const { return (uint32)variantInterfaces.size(); }
+        // number of distinct interfaces the variants reduced to
+        inline uint32 getInterfaceCount() const { return (uint32)interfaces.size(); }
+        // number of variants that had to be parsed
+        inline uint32 getParseCount() const { return parseCount; }
+
+        // reflection of a variant shared with every variant of the same interface, null if
+        // the variant failed
+        const ShaderInfo* getShaderInfo(uint32 variant) const;
+        // 0 if the variant failed
+        uint64 getInterfaceHash(uint32 variant) const;
+    private:
+        NULL_COPY_AND_ASSIGN(ShaderVariants);
+
+        static constexpr uint32 FAILED_INTERFACE = ~0u;
+
+        struct Interface {
+            uint64 hash;
+            Memory::SharedPointer<ShaderInfo> shaderInfo;
+        };
+
+        ArrayList<Interface> interfaces;
+        ArrayList<uint32> variantInterfaces;
+
+        uint32 parseCount = 0;
+};